@@ -40,74 +40,309 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include "edtaa3func.h"
 #include "distance_map.h"
+#include "distance_map_simd.h"
+#include "edt_separable.h"
+#include "edt_narrowband.h"
+#include "edt_sampled.h"
+#include "span_raster.h"
 
-// From freetype-gl.
-void make_distance_map( double *data, unsigned int width, unsigned int height )
+// Per-pixel passes of make_distance_map(). The generic versions are the
+// original freetype-gl loops; the float overloads run the vectorized
+// kernels from distance_map_simd.cpp with the same results.
+
+template <typename T>
+static void dm_gradient( T *data, unsigned int width, unsigned int height, T *gx, T *gy )
 {
-    short * xdist = (short *)  malloc( width * height * sizeof(short) );
-    short * ydist = (short *)  malloc( width * height * sizeof(short) );
-    double * gx   = (double *) calloc( width * height, sizeof(double) );
-    double * gy      = (double *) calloc( width * height, sizeof(double) );
-    double * outside = (double *) calloc( width * height, sizeof(double) );
-    double * inside  = (double *) calloc( width * height, sizeof(double) );
-    int i;
-    
-    // Compute outside = edtaa3(bitmap); % Transform background (0's)
-    computegradient( data, height, width, gx, gy);
-    edtaa3(data, gx, gy, width, height, xdist, ydist, outside);
-    for( i=0; i<width*height; ++i)
+    memset( gx, 0, sizeof(T)*width*height );
+    memset( gy, 0, sizeof(T)*width*height );
+    computegradient( data, height, width, gx, gy );
+}
+
+static void dm_gradient( float *data, unsigned int width, unsigned int height, float *gx, float *gy )
+{
+    dm_get_kernels().gradient( data, height, width, gx, gy );
+}
+
+template <typename T>
+static void dm_clamp_invert( T *outside, T *data, size_t n )
+{
+    for( size_t i=0; i<n; ++i)
     {
-        if( outside[i] < 0.0 )
+        if( outside[i] < 0 )
         {
-            outside[i] = 0.0;
+            outside[i] = 0;
         }
-    }
-    
-    // Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
-    memset( gx, 0, sizeof(double)*width*height );
-    memset( gy, 0, sizeof(double)*width*height );
-    for( i=0; i<width*height; ++i)
         data[i] = 1 - data[i];
-    computegradient( data, height, width, gx, gy );
-    edtaa3( data, gx, gy, width, height, xdist, ydist, inside );
-    for( i=0; i<width*height; ++i )
+    }
+}
+
+static void dm_clamp_invert( float *outside, float *data, size_t n )
+{
+    dm_get_kernels().clamp_invert( outside, data, n );
+}
+
+template <typename T>
+static T dm_subtract_min( T *outside, T *inside, size_t n )
+{
+    T vmin = +INFINITY;
+    for( size_t i=0; i<n; ++i)
     {
         if( inside[i] < 0 )
         {
-            inside[i] = 0.0;
+            inside[i] = 0;
         }
-    }
-    
-    // distmap = outside - inside; % Bipolar distance field
-    float vmin = +INFINITY;
-    for( i=0; i<width*height; ++i)
-    {
         outside[i] -= inside[i];
         if( outside[i] < vmin )
         {
             vmin = outside[i];
         }
     }
-    vmin = abs(vmin);
-    for( i=0; i<width*height; ++i)
+    return vmin;
+}
+
+static float dm_subtract_min( float *outside, float *inside, size_t n )
+{
+    return dm_get_kernels().subtract_min( outside, inside, n );
+}
+
+template <typename T>
+static void dm_normalize( T *outside, T *data, T vmin, size_t n )
+{
+    for( size_t i=0; i<n; ++i)
+    {
+        T v = outside[i];
+        if     ( v < -vmin) v = -vmin;
+        else if( v > +vmin) v = +vmin;
+        data[i] = (v+vmin)/(2*vmin);
+    }
+}
+
+static void dm_normalize( float *outside, float *data, float vmin, size_t n )
+{
+    dm_get_kernels().normalize( outside, data, vmin, n );
+}
+
+// Runs the distance transform selected in options.
+template <typename T, typename O>
+static void dm_transform( T *data, T *gx, T *gy, unsigned int width, unsigned int height,
+                         O *xdist, O *ydist, T *dist, dm_options const & options )
+{
+    if( options.narrow_band && options.spread > 0 )
+    {
+        edt_narrowband( data, gx, gy, width, height, xdist, ydist, dist, (T)options.spread );
+        return;
+    }
+    switch( options.engine )
+    {
+        case DM_ENGINE_SEPARABLE:
+            edt_separable( data, gx, gy, width, height, xdist, ydist, dist, options.threads );
+            break;
+        case DM_ENGINE_EDTAA3:
+        default:
+            edtaa3( data, gx, gy, width, height, xdist, ydist, dist );
+            break;
+    }
+}
+
+template <typename T>
+static void dm_grow( std::vector<T> & v, size_t n )
+{
+    if( v.size() < n )
+    {
+        v.resize( n );
+    }
+}
+
+template <typename T, typename O>
+static void dm_grow( dm_offsets<T, O> & offsets, size_t n, dm_layout layout )
+{
+    dm_grow( offsets.xdist, n );
+    dm_grow( offsets.ydist, n );
+    if( layout == DM_LAYOUT_PACKED )
+    {
+        dm_grow( offsets.cells, n );
+        dm_grow( offsets.cells_in, n );
+    }
+    else
+    {
+        dm_grow( offsets.xdist_in, n );
+        dm_grow( offsets.ydist_in, n );
+    }
+}
+
+template <typename T>
+void dm_workspace<T>::reserve( size_t n, dm_layout layout, bool wide_offsets )
+{
+    dm_grow( gx, n );
+    dm_grow( gy, n );
+    dm_grow( outside, n );
+    dm_grow( inside, n );
+    if( layout == DM_LAYOUT_PACKED )
     {
-        float v = outside[i];
-        if     ( v < -vmin) outside[i] = -vmin;
-        else if( v > +vmin) outside[i] = +vmin;
-        data[i] = (outside[i]+vmin)/(2*vmin);
+        dm_grow( source, n );
     }
+    if( wide_offsets )
+    {
+        dm_grow( offsets32, n, layout );
+    }
+    else
+    {
+        dm_grow( offsets16, n, layout );
+    }
+}
+
+// The gradient passes never write the one-pixel image border, which has
+// to read as zero. A reused workspace may hold anything there, so clear
+// it. (w,h) are the dimensions as passed to the gradient.
+template <typename T>
+static void dm_clear_border( T *g, unsigned int w, unsigned int h )
+{
+    if( w == 0 || h == 0 )
+    {
+        return;
+    }
+    std::fill( g, g + w, T(0) );
+    std::fill( g + (size_t)(h-1)*w, g + (size_t)h*w, T(0) );
+    for( size_t j=1; j+1<h; ++j )
+    {
+        g[j*w] = 0;
+        g[j*w + w-1] = 0;
+    }
+}
+
+// The fused edtaa3 transform in the layout selected in options.
+template <typename T, typename O>
+static void dm_bipolar( T *data, T *gx, T *gy, unsigned int width, unsigned int height,
+                       dm_workspace<T> & workspace, dm_offsets<T, O> & offsets, T *dist,
+                       dm_options const & options, edt_stats * stats,
+                       const edt_edge_table<T> * table )
+{
+    if( options.layout == DM_LAYOUT_PACKED )
+    {
+        edtaa3_bipolar_packed( data, gx, gy, width, height, workspace.source.data(),
+                               offsets.cells.data(), offsets.cells_in.data(), dist,
+                               options.limits, stats, table );
+    }
+    else
+    {
+        edtaa3_bipolar( data, gx, gy, width, height, offsets.xdist.data(), offsets.ydist.data(), dist,
+                        offsets.xdist_in.data(), offsets.ydist_in.data(), workspace.inside.data(),
+                        options.limits, stats, table );
+    }
+}
+
+// The bipolar field of data (gradient already in the workspace) into
+// workspace.outside, using the offset buffers given. Returns the value
+// that maps to the far end of the normalized range.
+template <typename T, typename O>
+static T dm_field( T *data, unsigned int width, unsigned int height,
+                  dm_workspace<T> & workspace, dm_offsets<T, O> & offsets,
+                  dm_options const & options, edt_stats * stats )
+{
+    size_t n = (size_t)width * height;
+    O * xdist = offsets.xdist.data();
+    O * ydist = offsets.ydist.data();
+    T * gx      = workspace.gx.data();
+    T * gy      = workspace.gy.data();
+    T * outside = workspace.outside.data();
+    T * inside  = workspace.inside.data();
     
-    free( xdist );
-    free( ydist );
-    free( gx );
-    free( gy );
-    free( outside );
-    free( inside );
+    T vmin;
+    if( options.engine == DM_ENGINE_EDTAA3 && !(options.narrow_band && options.spread > 0) )
+    {
+        // Both transforms in the same sweeps; outside becomes the bipolar field.
+        const edt_edge_table<T> * table = NULL;
+        if( options.edge_table || options.check_edge_table )
+        {
+            table = &edt_get_edge_table<T>();
+        }
+        dm_bipolar( data, gx, gy, width, height, workspace, offsets, outside, options, stats, table );
+        
+        if( options.check_edge_table )
+        {
+            // Run the exact transform as well and compare.
+            std::vector<T> table_result( outside, outside + n );
+            dm_bipolar( data, gx, gy, width, height, workspace, offsets, outside, options,
+                        (edt_stats *)NULL, (const edt_edge_table<T> *)NULL );
+            if( stats )
+            {
+                double emax = 0, esum = 0;
+                for( size_t i=0; i<n; ++i )
+                {
+                    double e = std::fabs( (double)table_result[i] - outside[i] );
+                    emax = std::max( emax, e );
+                    esum += e;
+                }
+                stats->table_checked = true;
+                stats->table_error_max = emax;
+                stats->table_error_mean = n ? esum/n : 0;
+            }
+            std::copy( table_result.begin(), table_result.end(), outside );
+        }
+        vmin = std::fabs( *std::min_element( outside, outside + n ) );
+    }
+    else
+    {
+        // Compute outside = edtaa3(bitmap); % Transform background (0's)
+        dm_transform( data, gx, gy, width, height, xdist, ydist, outside, options );
+        
+        // Clamp outside to positive values and invert the bitmap in one sweep.
+        dm_clamp_invert( outside, data, n );
+        
+        // Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
+        dm_transform( data, gx, gy, width, height, xdist, ydist, inside, options );
+        
+        // distmap = outside - inside; % Bipolar distance field
+        // (inside is clamped to positive values in the same sweep)
+        vmin = std::fabs( dm_subtract_min( outside, inside, n ) );
+    }
+    return vmin;
+}
+
+// From freetype-gl.
+template <typename T>
+void make_distance_map( T *data, unsigned int width, unsigned int height,
+                       dm_workspace<T> & workspace, dm_options const & options,
+                       edt_stats * stats )
+{
+    size_t n = (size_t)width * height;
+    bool wide = dm_offset_wide( width, height );
+    workspace.reserve( n, options.layout, wide );
+    
+    T * gx = workspace.gx.data();
+    T * gy = workspace.gy.data();
+    
+    // (The gradient is computed with width and height swapped.)
+    dm_clear_border( gx, height, width );
+    dm_clear_border( gy, height, width );
+    
+    // The gradient of 1-bitmap is the negated gradient of the bitmap, and
+    // the transforms only use its magnitude: one gradient serves both.
+    dm_gradient( data, width, height, gx, gy );
+    
+    // 16-bit offsets for everything but huge renders, where they would wrap.
+    T vmin = wide ? dm_field( data, width, height, workspace, workspace.offsets32, options, stats )
+                  : dm_field( data, width, height, workspace, workspace.offsets16, options, stats );
+    if( options.narrow_band && options.spread > 0 )
+    {
+        vmin = options.spread;
+    }
+    dm_normalize( workspace.outside.data(), data, vmin, n );
+}
+
+template <typename T>
+void make_distance_map( T *data, unsigned int width, unsigned int height,
+                       dm_options const & options )
+{
+    dm_workspace<T> workspace;
+    make_distance_map( data, width, height, workspace, options );
 }
 
 unsigned char *
@@ -115,18 +350,18 @@ make_distance_map( unsigned char *img, unsigned int width, unsigned int height )
 {
     short * xdist = (short *)  malloc( width * height * sizeof(short) );
     short * ydist = (short *)  malloc( width * height * sizeof(short) );
-    double * gx   = (double *) calloc( width * height, sizeof(double) );
-    double * gy      = (double *) calloc( width * height, sizeof(double) );
-    double * data    = (double *) calloc( width * height, sizeof(double) );
-    double * outside = (double *) calloc( width * height, sizeof(double) );
-    double * inside  = (double *) calloc( width * height, sizeof(double) );
+    float * gx      = (float *) calloc( width * height, sizeof(float) );
+    float * gy      = (float *) calloc( width * height, sizeof(float) );
+    float * data    = (float *) calloc( width * height, sizeof(float) );
+    float * outside = (float *) calloc( width * height, sizeof(float) );
+    float * inside  = (float *) calloc( width * height, sizeof(float) );
     int i;
     
-    // Convert img into double (data)
-    double img_min = 255, img_max = -255;
+    // Convert img into float (data)
+    float img_min = 255, img_max = -255;
     for( i=0; i<width*height; ++i)
     {
-        double v = img[i];
+        float v = img[i];
         data[i] = v;
         if (v > img_max) img_max = v;
         if (v < img_min) img_min = v;
@@ -142,18 +377,18 @@ make_distance_map( unsigned char *img, unsigned int width, unsigned int height )
     edtaa3(data, gx, gy, height, width, xdist, ydist, outside);
     for( i=0; i<width*height; ++i)
         if( outside[i] < 0 )
-            outside[i] = 0.0;
+            outside[i] = 0;
     
     // Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
-    memset(gx, 0, sizeof(double)*width*height );
-    memset(gy, 0, sizeof(double)*width*height );
+    memset(gx, 0, sizeof(float)*width*height );
+    memset(gy, 0, sizeof(float)*width*height );
     for( i=0; i<width*height; ++i)
         data[i] = 1 - data[i];
     computegradient( data, height, width, gx, gy);
     edtaa3(data, gx, gy, height, width, xdist, ydist, inside);
     for( i=0; i<width*height; ++i)
         if( inside[i] < 0 )
-            inside[i] = 0.0;
+            inside[i] = 0;
     
     // distmap = outside - inside; % Bipolar distance field
     unsigned char *out = (unsigned char *) malloc( width * height * sizeof(unsigned char) );
@@ -215,57 +450,594 @@ interpolate( float x, float y0, float y1, float y2, float y3 )
 
 
 // ------------------------------------------------------------------ scale ---
-int
-resize( double *src_data, size_t src_width, size_t src_height,
-       double *dst_data, size_t dst_width, size_t dst_height )
+
+// The taps and weights of every output pixel along one axis: output i
+// reads source pixels index[k*n+i] with weights weight[k*n+i], for
+// k < taps, n being dst_size.
+//
+// The Mitchell-Netravali filter has four taps, computed as the freetype-gl
+// resize() did per pixel. (Its phase is i/dst_size, not the sub-pixel
+// position, so there is one set of weights per output pixel.)
+//
+// The box filter averages the source pixels under output pixel i, the
+// range [i, i+1)*src_size/dst_size, weighting the pixels at either end by
+// how much of them is covered. For an integer ratio r this is the plain
+// average of r pixels.
+struct dm_resize_axis
 {
-    if( (src_width == dst_width) && (src_height == dst_height) )
+    dm_filter filter;
+    size_t n;
+    int taps;
+    std::vector<int> index;
+    std::vector<float> weight;
+    
+    void build( size_t src_size, size_t dst_size, dm_filter f )
     {
-        memcpy( dst_data, src_data, src_width*src_height*sizeof(double));
-        return 0;
+        filter = f;
+        n = dst_size;
+        if( filter == DM_FILTER_BOX )
+        {
+            build_box( src_size, dst_size );
+            return;
+        }
+        taps = 4;
+        index.resize( 4*n );
+        weight.resize( 4*n );
+        float scale = src_size / (float) dst_size;
+        for( size_t i=0; i < n; ++i )
+        {
+            int src_i = (int) floor( i * scale );
+            float x = i / (float) dst_size;
+            const float phase[4] = { x-1, x, x+1, x+2 };
+            for( int k=0; k < 4; ++k )
+            {
+                index[k*n+i] = std::min( std::max( 0, src_i-1+k ), (int)src_size-1 );
+                weight[k*n+i] = MitchellNetravali( phase[k] );
+            }
+        }
+    }
+    
+    void build_box( size_t src_size, size_t dst_size )
+    {
+        // Pixel i covers [i*src_size, (i+1)*src_size) in units of
+        // 1/dst_size source pixels, so integers describe it exactly.
+        taps = (int)((src_size + dst_size - 1) / dst_size) + 1;
+        index.assign( taps*n, 0 );
+        weight.assign( taps*n, 0.0f );
+        for( size_t i=0; i < n; ++i )
+        {
+            size_t a = i*src_size, b = (i+1)*src_size;
+            size_t first = a / dst_size;
+            for( int k=0; k < taps; ++k )
+            {
+                size_t p = std::min( first + k, src_size-1 );
+                size_t lo = std::max( a, (first + k)*dst_size );
+                size_t hi = std::min( b, (first + k + 1)*dst_size );
+                index[k*n+i] = (int)p;
+                weight[k*n+i] = hi > lo ? (float)((double)(hi - lo) / src_size) : 0.0f;
+            }
+        }
     }
-    size_t i,j;
-    float xscale = src_width / (float) dst_width;
-    float yscale = src_height / (float) dst_height;
-    for( j=0; j < dst_height; ++j )
+    
+    // Keeps only output pixels [first, first+count).
+    void crop( size_t first, size_t count )
     {
-        for( i=0; i < dst_width; ++i )
+        std::vector<int> cropped_index( taps*count );
+        std::vector<float> cropped_weight( taps*count );
+        for( int k=0; k < taps; ++k )
         {
-            int src_i = (int) floor( i * xscale );
-            int src_j = (int) floor( j * yscale );
-            int i0 = std::min( std::max( 0, src_i-1 ), (int)src_width-1 );
-            int i1 = std::min( std::max( 0, src_i   ), (int)src_width-1 );
-            int i2 = std::min( std::max( 0, src_i+1 ), (int)src_width-1 );
-            int i3 = std::min( std::max( 0, src_i+2 ), (int)src_width-1 );
-            int j0 = std::min( std::max( 0, src_j-1 ), (int)src_height-1 );
-            int j1 = std::min( std::max( 0, src_j   ), (int)src_height-1 );
-            int j2 = std::min( std::max( 0, src_j+1 ), (int)src_height-1 );
-            int j3 = std::min( std::max( 0, src_j+2 ), (int)src_height-1 );
-            float t0 = interpolate( i / (float) dst_width,
-                                   src_data[j0*src_width+i0],
-                                   src_data[j0*src_width+i1],
-                                   src_data[j0*src_width+i2],
-                                   src_data[j0*src_width+i3] );
-            float t1 = interpolate( i / (float) dst_width,
-                                   src_data[j1*src_width+i0],
-                                   src_data[j1*src_width+i1],
-                                   src_data[j1*src_width+i2],
-                                   src_data[j1*src_width+i3] );
-            float t2 = interpolate( i / (float) dst_width,
-                                   src_data[j2*src_width+i0],
-                                   src_data[j2*src_width+i1],
-                                   src_data[j2*src_width+i2],
-                                   src_data[j2*src_width+i3] );
-            float t3 = interpolate( i / (float) dst_width,
-                                   src_data[j3*src_width+i0],
-                                   src_data[j3*src_width+i1],
-                                   src_data[j3*src_width+i2],
-                                   src_data[j3*src_width+i3] );
-            float y =  interpolate( j / (float) dst_height, t0, t1, t2, t3 );
-            dst_data[j*dst_width+i] = y;
+            for( size_t i=0; i < count; ++i )
+            {
+                cropped_index[k*count+i] = index[k*n+first+i];
+                cropped_weight[k*count+i] = weight[k*n+first+i];
+            }
         }
+        index.swap( cropped_index );
+        weight.swap( cropped_weight );
+        n = count;
     }
+};
+
+// Where the resize functions below put their result: dst_width x
+// dst_height values of T at image or, if image is NULL, a window of them
+// quantized to bytes.
+template <typename T>
+struct dm_resize_dst
+{
+    T *image;
+    const dm_byte_window *window;
+    size_t width, height;
+    
+    // Row j of the output, counted from the top of the window.
+    void put( size_t j, const float *row ) const
+    {
+        if( image )
+        {
+            std::copy( row, row + width, image + j*width );
+            return;
+        }
+        unsigned char *d = window->data + j*window->stride;
+        for( size_t i=0; i < window->width; ++i )
+        {
+            d[i] = (unsigned char)std::round( 255*(1.0-row[i]) );
+        }
+    }
+};
+
+// The filter passes on one row. The generic versions convert to float, as
+// interpolate() does; the float overloads run the vectorized kernels.
+template <typename T>
+static void dm_filter_row( const T *src, dm_resize_axis const & axis, float *dst )
+{
+    const size_t n = axis.n;
+    const int *ix = axis.index.data();
+    const float *w = axis.weight.data();
+    for( size_t i=0; i < n; ++i )
+    {
+        float r = w[i]*(float)src[ix[i]];
+        for( int k=1; k < axis.taps; ++k )
+        {
+            r += w[k*n+i]*(float)src[ix[k*n+i]];
+        }
+        dst[i] = std::min( std::max( r, 0.0f ), 1.0f );
+    }
+}
+
+static void dm_filter_row( const float *src, dm_resize_axis const & axis, float *dst )
+{
+    dm_get_kernels().filter_row( src, axis.index.data(), axis.weight.data(), axis.taps, axis.n, dst );
+}
+
+template <typename S, typename T>
+static void dm_blend_rows( const S * const *rows, const float *c, int taps, size_t n, T *dst )
+{
+    for( size_t i=0; i < n; ++i )
+    {
+        float r = c[0]*(float)rows[0][i];
+        for( int k=1; k < taps; ++k )
+        {
+            r += c[k]*(float)rows[k][i];
+        }
+        dst[i] = std::min( std::max( r, 0.0f ), 1.0f );
+    }
+}
+
+static void dm_blend_rows( const float * const *rows, const float *c, int taps, size_t n, float *dst )
+{
+    dm_get_kernels().blend_rows( rows, c, taps, n, dst );
+}
+
+// Separable resize(): rows of src are src_stride apart (and that many
+// pixels wide), and xa and ya index columns and rows of src. Each source
+// row that is read is filtered horizontally once, into a float
+// intermediate; the output rows then blend ya.taps of those.
+//
+// The box filter reads every source row, so it goes the other way round:
+// blending whole rows first reads the source contiguously and leaves
+// only dst_height rows to filter. (The Mitchell filter clamps between the
+// passes, so its order is fixed.)
+//
+// With a window as the destination, only the window's pixels are
+// computed.
+template <typename T>
+static void dm_resize( const T *src, size_t src_stride,
+                       dm_resize_axis xa, dm_resize_axis ya, dm_resize_dst<T> const & dst )
+{
+    if( dst.window )
+    {
+        xa.crop( dst.window->x0, dst.window->width );
+        ya.crop( dst.window->y0, dst.window->height );
+    }
+    const size_t dst_width = xa.n, dst_height = ya.n;
+    std::vector<float> line( dst_width );
+    
+    if( ya.filter == DM_FILTER_BOX )
+    {
+        std::vector<float> tmp( src_stride ), c( ya.taps );
+        std::vector<const T *> taps( ya.taps );
+        for( size_t j=0; j < dst_height; ++j )
+        {
+            for( int k=0; k < ya.taps; ++k )
+            {
+                taps[k] = src + (size_t)ya.index[k*dst_height+j]*src_stride;
+                c[k] = ya.weight[k*dst_height+j];
+            }
+            dm_blend_rows( taps.data(), c.data(), ya.taps, src_stride, tmp.data() );
+            dm_filter_row( tmp.data(), xa, line.data() );
+            dst.put( j, line.data() );
+        }
+        return;
+    }
+    
+    // The source rows read, and the intermediate row of each.
+    std::vector<int> rows( ya.index );
+    std::sort( rows.begin(), rows.end() );
+    rows.erase( std::unique( rows.begin(), rows.end() ), rows.end() );
+    std::vector<int> slot( ya.index.size() );
+    for( size_t k=0; k < slot.size(); ++k )
+    {
+        slot[k] = (int)(std::lower_bound( rows.begin(), rows.end(), ya.index[k] ) - rows.begin());
+    }
+    
+    std::vector<float> tmp( rows.size()*dst_width );
+    for( size_t r=0; r < rows.size(); ++r )
+    {
+        dm_filter_row( src + (size_t)rows[r]*src_stride, xa, &tmp[r*dst_width] );
+    }
+    
+    std::vector<const float *> taps( ya.taps );
+    std::vector<float> c( ya.taps );
+    for( size_t j=0; j < dst_height; ++j )
+    {
+        for( int k=0; k < ya.taps; ++k )
+        {
+            taps[k] = &tmp[(size_t)slot[k*dst_height+j]*dst_width];
+            c[k] = ya.weight[k*dst_height+j];
+        }
+        dm_blend_rows( taps.data(), c.data(), ya.taps, dst_width, line.data() );
+        dst.put( j, line.data() );
+    }
+}
+
+// dm_resize() between equal sizes: a copy.
+template <typename T>
+static void dm_resize_copy( const T *src, dm_resize_dst<T> const & dst )
+{
+    if( dst.image )
+    {
+        memcpy( dst.image, src, dst.width*dst.height*sizeof(T) );
+        return;
+    }
+    std::vector<float> line( dst.window->width );
+    for( size_t j=0; j < dst.window->height; ++j )
+    {
+        const T *row = src + (dst.window->y0 + j)*dst.width + dst.window->x0;
+        std::copy( row, row + line.size(), line.begin() );
+        dst.put( j, line.data() );
+    }
+}
+
+template <typename T>
+static void dm_resize_image( const T *src_data, size_t src_width, size_t src_height,
+                             dm_resize_dst<T> const & dst, dm_filter filter )
+{
+    if( (src_width == dst.width) && (src_height == dst.height) )
+    {
+        dm_resize_copy( src_data, dst );
+        return;
+    }
+    dm_resize_axis xa, ya;
+    xa.build( src_width, dst.width, filter );
+    ya.build( src_height, dst.height, filter );
+    dm_resize( src_data, src_width, xa, ya, dst );
+}
+
+template <typename T>
+int
+resize( T *src_data, size_t src_width, size_t src_height,
+       T *dst_data, size_t dst_width, size_t dst_height, dm_filter filter )
+{
+    dm_resize_dst<T> dst = { dst_data, NULL, dst_width, dst_height };
+    dm_resize_image( src_data, src_width, src_height, dst, filter );
+    return 0;
+}
+
+template <typename T>
+int
+resize( T *src_data, size_t src_width, size_t src_height,
+       dm_byte_window const & window, size_t dst_width, size_t dst_height, dm_filter filter )
+{
+    dm_resize_dst<T> dst = { NULL, &window, dst_width, dst_height };
+    dm_resize_image( src_data, src_width, src_height, dst, filter );
     return 0;
 }
 
 // End of freetype-gl functions.
+
+// The source columns (or rows) resize() reads when scaling src_size pixels
+// to dst_size with filter, in increasing order.
+static void resize_taps( size_t src_size, size_t dst_size, dm_filter filter, std::vector<int> & taps )
+{
+    taps.clear();
+    if( src_size == dst_size )
+    {
+        for( size_t i=0; i < src_size; ++i )
+        {
+            taps.push_back( (int)i );
+        }
+        return;
+    }
+    dm_resize_axis axis;
+    axis.build( src_size, dst_size, filter );
+    taps = axis.index;
+    std::sort( taps.begin(), taps.end() );
+    taps.erase( std::unique( taps.begin(), taps.end() ), taps.end() );
+}
+
+// resize() of a src_width x src_height image of which only the pixels at
+// columns xs and rows ys (from resize_taps()) are known; grid holds them,
+// row by row. The results are the same as resize() on the full image.
+template <typename T>
+static void resize_grid( const T *grid, std::vector<int> const & xs, std::vector<int> const & ys,
+                         size_t src_width, size_t src_height,
+                         dm_resize_dst<T> const & dst, dm_filter filter )
+{
+    if( (src_width == dst.width) && (src_height == dst.height) )
+    {
+        dm_resize_copy( grid, dst );
+        return;
+    }
+    dm_resize_axis xa, ya;
+    xa.build( src_width, dst.width, filter );
+    ya.build( src_height, dst.height, filter );
+    
+    // Point the taps at the grid instead of the full image.
+    std::vector<int> col( src_width, 0 ), row( src_height, 0 );
+    for( size_t k=0; k < xs.size(); ++k ) col[xs[k]] = (int)k;
+    for( size_t k=0; k < ys.size(); ++k ) row[ys[k]] = (int)k;
+    for( size_t k=0; k < xa.index.size(); ++k ) xa.index[k] = col[xa.index[k]];
+    for( size_t k=0; k < ya.index.size(); ++k ) ya.index[k] = row[ya.index[k]];
+    
+    dm_resize( grid, xs.size(), xa, ya, dst );
+}
+
+// Normalizes the sampled field to [0,1] over [-spread, +spread] and
+// resizes it into dst.
+template <typename T>
+static void dm_resize_samples( std::vector<T> & samples, std::vector<int> const & xs,
+                               std::vector<int> const & ys, T spread,
+                               size_t width, size_t height,
+                               dm_resize_dst<T> const & dst, dm_filter filter )
+{
+    for( size_t i=0; i < xs.size()*ys.size(); ++i )
+    {
+        T v = samples[i];
+        if     ( v < -spread) v = -spread;
+        else if( v > +spread) v = +spread;
+        samples[i] = (v+spread)/(2*spread);
+    }
+    resize_grid( samples.data(), xs, ys, width, height, dst, filter );
+}
+
+template <typename T>
+static void dm_sampled( T *data, unsigned int width, unsigned int height,
+                        dm_resize_dst<T> const & dst,
+                        dm_workspace<T> & workspace, dm_options const & options )
+{
+    const size_t dst_width = dst.width, dst_height = dst.height;
+    size_t n = (size_t)width * height;
+    dm_grow( workspace.gx, n );
+    dm_grow( workspace.gy, n );
+    T * gx = workspace.gx.data();
+    T * gy = workspace.gy.data();
+    
+    // Unlike make_distance_map(), use the gradient of the image as it is
+    // laid out (dm_gradient() swaps the dimensions it is given).
+    dm_clear_border( gx, width, height );
+    dm_clear_border( gy, width, height );
+    dm_gradient( data, height, width, gx, gy );
+    
+    std::vector<int> xs, ys;
+    resize_taps( width, dst_width, options.filter, xs );
+    resize_taps( height, dst_height, options.filter, ys );
+    
+    T spread = options.spread > 0 ? (T)options.spread : (T)std::max( width, height );
+    std::vector<T> & samples = workspace.outside;
+    dm_grow( samples, xs.size()*ys.size() );
+    edt_sampled( data, gx, gy, width, height, xs, ys, spread + 2, samples.data() );
+    
+    dm_resize_samples( samples, xs, ys, spread, width, height, dst, options.filter );
+}
+
+template <typename T>
+void make_sampled_distance_map( T *data, unsigned int width, unsigned int height,
+                               T *dst_data, size_t dst_width, size_t dst_height,
+                               dm_workspace<T> & workspace, dm_options const & options )
+{
+    dm_resize_dst<T> dst = { dst_data, NULL, dst_width, dst_height };
+    dm_sampled( data, width, height, dst, workspace, options );
+}
+
+template <typename T>
+void make_sampled_distance_map( T *data, unsigned int width, unsigned int height,
+                               dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                               dm_workspace<T> & workspace, dm_options const & options )
+{
+    dm_resize_dst<T> dst = { NULL, &window, dst_width, dst_height };
+    dm_sampled( data, width, height, dst, workspace, options );
+}
+
+template <typename T>
+static void dm_spans( span_raster const & spans, dm_resize_dst<T> const & dst,
+                      dm_workspace<T> & workspace, dm_options const & options )
+{
+    const size_t dst_width = dst.width, dst_height = dst.height;
+    std::vector<int> xs, ys;
+    resize_taps( spans.width, dst_width, options.filter, xs );
+    resize_taps( spans.height, dst_height, options.filter, ys );
+    
+    T spread = options.spread > 0 ? (T)options.spread : (T)std::max( spans.width, spans.height );
+    std::vector<T> & samples = workspace.outside;
+    dm_grow( samples, xs.size()*ys.size() );
+    edt_sampled_spans( spans, xs, ys, spread + 2, samples.data() );
+    
+    dm_resize_samples( samples, xs, ys, spread, spans.width, spans.height, dst, options.filter );
+}
+
+template <typename T>
+void make_span_distance_map( span_raster const & spans,
+                            T *dst_data, size_t dst_width, size_t dst_height,
+                            dm_workspace<T> & workspace, dm_options const & options )
+{
+    dm_resize_dst<T> dst = { dst_data, NULL, dst_width, dst_height };
+    dm_spans( spans, dst, workspace, options );
+}
+
+template <typename T>
+void make_span_distance_map( span_raster const & spans,
+                            dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                            dm_workspace<T> & workspace, dm_options const & options )
+{
+    dm_resize_dst<T> dst = { NULL, &window, dst_width, dst_height };
+    dm_spans( spans, dst, workspace, options );
+}
+
+template <typename T>
+static void dm_banded( dm_band_source<T> const & source, unsigned int width, unsigned int height,
+                       dm_resize_dst<T> const & dst, dm_workspace<T> & workspace,
+                       dm_options const & options )
+{
+    dm_options band_options = options;
+    band_options.narrow_band = true;
+    // The gradient reads one more row, and leaves the band's border at zero.
+    const size_t halo = (size_t)std::ceil( options.spread ) + 2;
+    const size_t band_rows = options.band_rows > 0 ? options.band_rows : dst.height;
+    
+    dm_resize_axis xa, ya;
+    xa.build( width, dst.width, options.filter );
+    ya.build( height, dst.height, options.filter );
+    dm_byte_window part_window = { NULL, 0, 0, 0, 0, 0 };
+    if( dst.window )
+    {
+        xa.crop( dst.window->x0, dst.window->width );
+        ya.crop( dst.window->y0, dst.window->height );
+        part_window = *dst.window;
+        part_window.x0 = 0;
+        part_window.y0 = 0;
+    }
+    
+    std::vector<T> & band = workspace.band;
+    for( size_t r0=0; r0 < ya.n; r0 += band_rows )
+    {
+        const size_t r1 = std::min( r0 + band_rows, ya.n );
+        dm_resize_axis yb = ya;
+        yb.crop( r0, r1 - r0 );
+        
+        // Input rows this band of output reads, plus the halo.
+        const size_t lo = *std::min_element( yb.index.begin(), yb.index.end() );
+        const size_t hi = *std::max_element( yb.index.begin(), yb.index.end() ) + 1;
+        const size_t b0 = lo > halo ? lo - halo : 0;
+        const size_t b1 = std::min( hi + halo, (size_t)height );
+        for( size_t k=0; k < yb.index.size(); ++k )
+        {
+            yb.index[k] -= (int)b0;
+        }
+        
+        band.assign( (size_t)width*(b1 - b0), T(0) );
+        source.render( b0, b1, band.data(), source.user );
+        make_distance_map( band.data(), width, (unsigned int)(b1 - b0), workspace, band_options );
+        
+        dm_resize_dst<T> part = { NULL, NULL, dst.width, r1 - r0 };
+        if( dst.window )
+        {
+            part_window.data = dst.window->data + r0*dst.window->stride;
+            part_window.height = r1 - r0;
+            part.window = &part_window;
+        }
+        else
+        {
+            part.image = dst.image + r0*dst.width;
+        }
+        dm_resize( band.data(), width, xa, yb, part );
+    }
+}
+
+template <typename T>
+void make_banded_distance_map( dm_band_source<T> const & source, unsigned int width, unsigned int height,
+                              T *dst_data, size_t dst_width, size_t dst_height,
+                              dm_workspace<T> & workspace, dm_options const & options )
+{
+    dm_resize_dst<T> dst = { dst_data, NULL, dst_width, dst_height };
+    dm_banded( source, width, height, dst, workspace, options );
+}
+
+template <typename T>
+void make_banded_distance_map( dm_band_source<T> const & source, unsigned int width, unsigned int height,
+                              dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                              dm_workspace<T> & workspace, dm_options const & options )
+{
+    dm_resize_dst<T> dst = { NULL, &window, dst_width, dst_height };
+    dm_banded( source, width, height, dst, workspace, options );
+}
+
+// Explicit instantiations: float for production, double as a reference.
+template struct dm_workspace<float>;
+template struct dm_workspace<double>;
+template void make_distance_map<float>( float *data, unsigned int width, unsigned int height,
+                                       dm_workspace<float> & workspace,
+                                       dm_options const & options, edt_stats * stats );
+template void make_distance_map<double>( double *data, unsigned int width, unsigned int height,
+                                        dm_workspace<double> & workspace,
+                                        dm_options const & options, edt_stats * stats );
+template void make_distance_map<float>( float *data, unsigned int width, unsigned int height,
+                                       dm_options const & options );
+template void make_distance_map<double>( double *data, unsigned int width, unsigned int height,
+                                        dm_options const & options );
+template void make_sampled_distance_map<float>( float *data, unsigned int width, unsigned int height,
+                                               float *dst_data, size_t dst_width, size_t dst_height,
+                                               dm_workspace<float> & workspace,
+                                               dm_options const & options );
+template void make_sampled_distance_map<double>( double *data, unsigned int width, unsigned int height,
+                                                double *dst_data, size_t dst_width, size_t dst_height,
+                                                dm_workspace<double> & workspace,
+                                                dm_options const & options );
+template void make_sampled_distance_map<float>( float *data, unsigned int width, unsigned int height,
+                                               dm_byte_window const & window,
+                                               size_t dst_width, size_t dst_height,
+                                               dm_workspace<float> & workspace,
+                                               dm_options const & options );
+template void make_sampled_distance_map<double>( double *data, unsigned int width, unsigned int height,
+                                                dm_byte_window const & window,
+                                                size_t dst_width, size_t dst_height,
+                                                dm_workspace<double> & workspace,
+                                                dm_options const & options );
+template void make_span_distance_map<float>( span_raster const & spans,
+                                            float *dst_data, size_t dst_width, size_t dst_height,
+                                            dm_workspace<float> & workspace,
+                                            dm_options const & options );
+template void make_span_distance_map<double>( span_raster const & spans,
+                                             double *dst_data, size_t dst_width, size_t dst_height,
+                                             dm_workspace<double> & workspace,
+                                             dm_options const & options );
+template void make_span_distance_map<float>( span_raster const & spans,
+                                            dm_byte_window const & window,
+                                            size_t dst_width, size_t dst_height,
+                                            dm_workspace<float> & workspace,
+                                            dm_options const & options );
+template void make_span_distance_map<double>( span_raster const & spans,
+                                             dm_byte_window const & window,
+                                             size_t dst_width, size_t dst_height,
+                                             dm_workspace<double> & workspace,
+                                             dm_options const & options );
+template int resize<float>( float *src_data, size_t src_width, size_t src_height,
+                           float *dst_data, size_t dst_width, size_t dst_height, dm_filter filter );
+template int resize<double>( double *src_data, size_t src_width, size_t src_height,
+                            double *dst_data, size_t dst_width, size_t dst_height, dm_filter filter );
+template void make_banded_distance_map<float>( dm_band_source<float> const & source,
+                                              unsigned int width, unsigned int height,
+                                              float *dst_data, size_t dst_width, size_t dst_height,
+                                              dm_workspace<float> & workspace,
+                                              dm_options const & options );
+template void make_banded_distance_map<double>( dm_band_source<double> const & source,
+                                               unsigned int width, unsigned int height,
+                                               double *dst_data, size_t dst_width, size_t dst_height,
+                                               dm_workspace<double> & workspace,
+                                               dm_options const & options );
+template void make_banded_distance_map<float>( dm_band_source<float> const & source,
+                                              unsigned int width, unsigned int height,
+                                              dm_byte_window const & window,
+                                              size_t dst_width, size_t dst_height,
+                                              dm_workspace<float> & workspace,
+                                              dm_options const & options );
+template void make_banded_distance_map<double>( dm_band_source<double> const & source,
+                                               unsigned int width, unsigned int height,
+                                               dm_byte_window const & window,
+                                               size_t dst_width, size_t dst_height,
+                                               dm_workspace<double> & workspace,
+                                               dm_options const & options );
+template int resize<float>( float *src_data, size_t src_width, size_t src_height,
+                           dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                           dm_filter filter );
+template int resize<double>( double *src_data, size_t src_width, size_t src_height,
+                            dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                            dm_filter filter );
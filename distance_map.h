@@ -41,12 +41,208 @@
 #ifndef __makeglfont__distance_map__
 #define __makeglfont__distance_map__
 
-void make_distance_map( double *data, unsigned int width, unsigned int height );
+#include <cstddef>
+#include <vector>
+
+#include "edtaa3func.h"
+
+struct span_raster;
+
+// The distance map and resize functions are templated on the scalar type.
+// They are instantiated for float (production) and double (reference).
+
+// Distance transform used by make_distance_map().
+enum dm_engine
+{
+    DM_ENGINE_EDTAA3,    // Gustavson's sweep-and-update transform (iterates until stable)
+    DM_ENGINE_SEPARABLE, // Exact separable transform, one column and one row pass
+    DM_ENGINE_ANALYTIC,  // Distances from the glyph outline (outline_sdf.h), no raster.
+                         // make_distance_map() treats it as DM_ENGINE_EDTAA3.
+    DM_ENGINE_SAMPLED    // Distances only where resize() reads them (edt_sampled.h), see
+                         // make_sampled_distance_map(). make_distance_map() treats it
+                         // as DM_ENGINE_EDTAA3.
+};
+
+// Memory layout of the edtaa3 engine's per-pixel state. The packed
+// layout touches fewer streams per candidate, but the transform is mostly
+// bound by its arithmetic, so it only pays off where memory is the
+// bottleneck; the planar layout is the default.
+enum dm_layout
+{
+    DM_LAYOUT_PLANAR, // One array per field (edtaa3_bipolar)
+    DM_LAYOUT_PACKED  // Interleaved records (edtaa3_bipolar_packed)
+};
+
+// Downsampling filter of resize().
+enum dm_filter
+{
+    DM_FILTER_MITCHELL, // Mitchell-Netravali cubic, 4x4 taps (freetype-gl's filter)
+    DM_FILTER_BOX       // Area average over each output pixel's footprint
+};
+
+struct dm_options
+{
+    dm_engine engine;
+    dm_layout layout;
+    int threads; // worker threads for engines that can split the image (0 = all cores)
+    
+    // Narrow-band mode: only compute distances up to "spread" pixels from
+    // the edge (replacing the engine), and normalize the output to
+    // [-spread, +spread] instead of the largest inside distance.
+    bool narrow_band;
+    float spread;
+    
+    // Bounds on the edtaa3 engine's sweep loop (see edtaa3func.h).
+    edt_limits limits;
+    
+    // edtaa3 engine: take the edge term of the distance from a table
+    // (edt_edge_table). With check_edge_table, also run the exact transform
+    // and report the difference in the stats.
+    bool edge_table;
+    bool check_edge_table;
+    
+    // Multi-channel output (MSDF). Needs the glyph outline, so it always
+    // uses the analytic engine.
+    bool msdf;
+    
+    // Rasterize glyphs into runs (span_raster.h) rather than a bitmap and
+    // use make_span_distance_map(). Sampled engine only.
+    bool spans;
+    
+    // Filter for the downsampling done by make_sampled_distance_map() and
+    // make_span_distance_map() (callers pass it to resize() otherwise).
+    dm_filter filter;
+    
+    // Output rows per band in make_banded_distance_map() (0 = whole image).
+    int band_rows;
+    
+    dm_options():engine(DM_ENGINE_EDTAA3), layout(DM_LAYOUT_PLANAR), threads(0), narrow_band(false), spread(0),
+                 edge_table(false), check_edge_table(false), msdf(false), spans(false),
+                 filter(DM_FILTER_MITCHELL), band_rows(0) {}
+};
+
+// Largest width or height make_distance_map() handles with 16-bit edge
+// offsets. Larger images use 32-bit offsets (see dm_offset_wide()).
+#define DM_SHORT_OFFSET_MAX_SIZE 32767
+
+// True if an image this size needs 32-bit edge offsets.
+inline bool dm_offset_wide( unsigned int width, unsigned int height )
+{
+    return width > DM_SHORT_OFFSET_MAX_SIZE || height > DM_SHORT_OFFSET_MAX_SIZE;
+}
+
+// Edge offset buffers of one offset type O.
+template <typename T, typename O>
+struct dm_offsets
+{
+    std::vector<O> xdist, ydist;
+    std::vector<O> xdist_in, ydist_in;        // planar edtaa3 only
+    std::vector< edt_cell<T, O> > cells, cells_in; // packed edtaa3 only
+};
+
+// Where the resizing functions can put their result instead of an image
+// of T: the window (x0, y0, width, height) of the dst_width x dst_height
+// result, each value v stored as the byte round(255*(1-v)), with rows
+// stride bytes apart (top row first). This is how glyphs are written
+// straight into their rectangle of the atlas.
+struct dm_byte_window
+{
+    unsigned char *data;
+    size_t stride;
+    size_t x0, y0, width, height;
+};
+
+// Scratch buffers for make_distance_map(). They only ever grow, so a
+// workspace reused across glyphs stops allocating once it has seen the
+// largest one. A workspace is not thread-safe; keep one per worker thread.
+template <typename T>
+struct dm_workspace
+{
+    std::vector<T> gx, gy, outside, inside;
+    std::vector<T> band;                   // input rows, make_banded_distance_map() only
+    std::vector< edt_source<T> > source;   // packed edtaa3 only
+    dm_offsets<T, short> offsets16;        // images up to DM_SHORT_OFFSET_MAX_SIZE
+    dm_offsets<T, int> offsets32;          // anything larger
+    
+    // Makes the buffers used with this layout and offset size hold at
+    // least n elements. Contents are undefined.
+    void reserve( size_t n, dm_layout layout, bool wide_offsets = false );
+};
+
+// If stats is given, it receives the edtaa3 engine's pass counts (it is
+// left untouched by the other engines).
+template <typename T>
+void make_distance_map( T *data, unsigned int width, unsigned int height,
+                       dm_workspace<T> & workspace,
+                       dm_options const & options = dm_options(),
+                       edt_stats * stats = NULL );
+template <typename T>
+void make_distance_map( T *data, unsigned int width, unsigned int height,
+                       dm_options const & options = dm_options() );
+// make_distance_map() followed by resize() into dst_data, with the distance
+// field evaluated only at the source pixels resize() reads (about 16 per
+// output pixel with the Mitchell filter; the box filter reads them all). Distances are normalized to options.spread. data is
+// left unchanged.
+template <typename T>
+void make_sampled_distance_map( T *data, unsigned int width, unsigned int height,
+                               T *dst_data, size_t dst_width, size_t dst_height,
+                               dm_workspace<T> & workspace,
+                               dm_options const & options = dm_options() );
+template <typename T>
+void make_sampled_distance_map( T *data, unsigned int width, unsigned int height,
+                               dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                               dm_workspace<T> & workspace,
+                               dm_options const & options = dm_options() );
+// make_sampled_distance_map() for an image given as runs of equal
+// coverage (coverage 255 being 1). Only the edge pixels are expanded.
+template <typename T>
+void make_span_distance_map( span_raster const & spans,
+                            T *dst_data, size_t dst_width, size_t dst_height,
+                            dm_workspace<T> & workspace,
+                            dm_options const & options = dm_options() );
+template <typename T>
+void make_span_distance_map( span_raster const & spans,
+                            dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                            dm_workspace<T> & workspace,
+                            dm_options const & options = dm_options() );
+// Source of the input image for make_banded_distance_map(): render()
+// writes rows [y0, y1) of the width-pixel wide image, top row first and
+// normalized like make_distance_map()'s data, into rows (cleared to 0).
+template <typename T>
+struct dm_band_source
+{
+    void (*render)( size_t y0, size_t y1, T *rows, void *user );
+    void *user;
+};
+// make_distance_map() with the narrow-band transform followed by resize()
+// into dst_data, without ever holding the whole input: the output is made
+// options.band_rows rows at a time, each from the input rows resize()
+// reads for it plus a halo of options.spread rows on both sides, which is
+// as far as the narrow band reaches. Memory is bounded by the band height
+// rather than the image height. options.spread must be set.
+template <typename T>
+void make_banded_distance_map( dm_band_source<T> const & source, unsigned int width, unsigned int height,
+                              T *dst_data, size_t dst_width, size_t dst_height,
+                              dm_workspace<T> & workspace,
+                              dm_options const & options = dm_options() );
+template <typename T>
+void make_banded_distance_map( dm_band_source<T> const & source, unsigned int width, unsigned int height,
+                              dm_byte_window const & window, size_t dst_width, size_t dst_height,
+                              dm_workspace<T> & workspace,
+                              dm_options const & options = dm_options() );
 unsigned char * make_distance_map( unsigned char *img, unsigned int width, unsigned int height );
 float MitchellNetravali( float x );
 float interpolate( float x, float y0, float y1, float y2, float y3 );
-int resize( double *src_data, size_t src_width, size_t src_height,
-           double *dst_data, size_t dst_width, size_t dst_height );
+template <typename T>
+int resize( T *src_data, size_t src_width, size_t src_height,
+           T *dst_data, size_t dst_width, size_t dst_height,
+           dm_filter filter = DM_FILTER_MITCHELL );
+// resize() into a window of bytes (see dm_byte_window); only the window
+// is computed.
+template <typename T>
+int resize( T *src_data, size_t src_width, size_t src_height,
+           dm_byte_window const & window, size_t dst_width, size_t dst_height,
+           dm_filter filter = DM_FILTER_MITCHELL );
 
 
 #endif /* defined(__makeglfont__distance_map__) */
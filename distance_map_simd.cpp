@@ -0,0 +1,449 @@
+//
+//  distance_map_simd.cpp
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#include <cmath>
+#include <algorithm>
+
+#include "distance_map_simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define DM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(DM_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define DM_HAVE_AVX2 1
+#define DM_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(DM_HAVE_SSE2) && defined(_MSC_VER)
+#define DM_HAVE_AVX2 1
+#define DM_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+static const float dm_sqrt2 = 1.4142136f;
+
+// ------------------------------------------------------------- scalar ---
+
+// Gradient of one row from x0 to x1 (exclusive); also used for the tails
+// of the vector versions.
+static inline void gradient_row_scalar(const float *img, int w, int row, int x0, int x1,
+                                       float *gx, float *gy)
+{
+    for(int j = x0; j < x1; j++) {
+        int k = row*w + j;
+        float g_x = 0, g_y = 0;
+        if((img[k]>0) && (img[k]<1)) {
+            g_x = -img[k-w-1] - dm_sqrt2*img[k-1] - img[k+w-1] + img[k-w+1] + dm_sqrt2*img[k+1] + img[k+w+1];
+            g_y = -img[k-w-1] - dm_sqrt2*img[k-w] - img[k+w-1] + img[k-w+1] + dm_sqrt2*img[k+w] + img[k+w+1];
+            float glength = g_x*g_x + g_y*g_y;
+            if(glength > 0) {
+                glength = std::sqrt(glength);
+                g_x = g_x/glength;
+                g_y = g_y/glength;
+            }
+        }
+        gx[k] = g_x;
+        gy[k] = g_y;
+    }
+}
+
+static void gradient_scalar(const float *img, int w, int h, float *gx, float *gy)
+{
+    for(int i = 1; i < h-1; i++) {
+        gradient_row_scalar(img, w, i, 1, w-1, gx, gy);
+    }
+}
+
+static void clamp_invert_scalar(float *outside, float *data, size_t n)
+{
+    for(size_t i = 0; i < n; ++i) {
+        if(outside[i] < 0) outside[i] = 0;
+        data[i] = 1 - data[i];
+    }
+}
+
+static float subtract_min_scalar(float *outside, float *inside, size_t n)
+{
+    float vmin = +INFINITY;
+    for(size_t i = 0; i < n; ++i) {
+        if(inside[i] < 0) inside[i] = 0;
+        outside[i] -= inside[i];
+        if(outside[i] < vmin) vmin = outside[i];
+    }
+    return vmin;
+}
+
+static void normalize_scalar(const float *outside, float *data, float vmin, size_t n)
+{
+    const float range = 2*vmin;
+    for(size_t i = 0; i < n; ++i) {
+        float v = std::min(std::max(outside[i], -vmin), vmin);
+        data[i] = (v+vmin)/range;
+    }
+}
+
+// Output pixel i of filter_row(); also used for the tails of the vector versions.
+static inline float filter_pixel_scalar(const float *src, const int *index, const float *weight,
+                                        int taps, size_t n, size_t i)
+{
+    float r = weight[i]*src[index[i]];
+    for(int k = 1; k < taps; k++) {
+        r += weight[k*n+i]*src[index[k*n+i]];
+    }
+    return std::min(std::max(r, 0.0f), 1.0f);
+}
+
+static void filter_row_scalar(const float *src, const int *index, const float *weight, int taps,
+                              size_t n, float *dst)
+{
+    for(size_t i = 0; i < n; ++i) {
+        dst[i] = filter_pixel_scalar(src, index, weight, taps, n, i);
+    }
+}
+
+// Output pixel i of blend_rows(), likewise.
+static inline float blend_pixel_scalar(const float * const *rows, const float *c, int taps,
+                                       size_t i)
+{
+    float r = c[0]*rows[0][i];
+    for(int k = 1; k < taps; k++) {
+        r += c[k]*rows[k][i];
+    }
+    return std::min(std::max(r, 0.0f), 1.0f);
+}
+
+static void blend_rows_scalar(const float * const *rows, const float *c, int taps, size_t n,
+                              float *dst)
+{
+    for(size_t i = 0; i < n; ++i) {
+        dst[i] = blend_pixel_scalar(rows, c, taps, i);
+    }
+}
+
+static const dm_kernels scalar_kernels = {
+    "scalar", gradient_scalar, clamp_invert_scalar, subtract_min_scalar, normalize_scalar,
+    filter_row_scalar, blend_rows_scalar
+};
+
+#ifdef DM_HAVE_SSE2
+
+// --------------------------------------------------------------- SSE2 ---
+
+static void gradient_sse2(const float *img, int w, int h, float *gx, float *gy)
+{
+    const __m128 s2 = _mm_set1_ps(dm_sqrt2);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for(int i = 1; i < h-1; i++) {
+        int j = 1;
+        for(; j+4 <= w-1; j += 4) {
+            int k = i*w + j;
+            __m128 ul = _mm_loadu_ps(img+k-w-1), u = _mm_loadu_ps(img+k-w), ur = _mm_loadu_ps(img+k-w+1);
+            __m128 l  = _mm_loadu_ps(img+k-1),   c = _mm_loadu_ps(img+k),   r  = _mm_loadu_ps(img+k+1);
+            __m128 dl = _mm_loadu_ps(img+k+w-1), d = _mm_loadu_ps(img+k+w), dr = _mm_loadu_ps(img+k+w+1);
+            __m128 nul = _mm_xor_ps(ul, sign);
+            __m128 vx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_sub_ps(nul, _mm_mul_ps(s2, l)), dl), ur), _mm_mul_ps(s2, r)), dr);
+            __m128 vy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_sub_ps(nul, _mm_mul_ps(s2, u)), dl), ur), _mm_mul_ps(s2, d)), dr);
+            __m128 gl = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+            __m128 nz = _mm_cmpgt_ps(gl, zero);
+            __m128 len = _mm_sqrt_ps(gl);
+            vx = _mm_or_ps(_mm_and_ps(nz, _mm_div_ps(vx, len)), _mm_andnot_ps(nz, vx));
+            vy = _mm_or_ps(_mm_and_ps(nz, _mm_div_ps(vy, len)), _mm_andnot_ps(nz, vy));
+            __m128 edge = _mm_and_ps(_mm_cmpgt_ps(c, zero), _mm_cmplt_ps(c, one));
+            _mm_storeu_ps(gx+k, _mm_and_ps(edge, vx));
+            _mm_storeu_ps(gy+k, _mm_and_ps(edge, vy));
+        }
+        gradient_row_scalar(img, w, i, j, w-1, gx, gy);
+    }
+}
+
+static void clamp_invert_sse2(float *outside, float *data, size_t n)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i+4 <= n; i += 4) {
+        _mm_storeu_ps(outside+i, _mm_max_ps(_mm_loadu_ps(outside+i), zero));
+        _mm_storeu_ps(data+i, _mm_sub_ps(one, _mm_loadu_ps(data+i)));
+    }
+    clamp_invert_scalar(outside+i, data+i, n-i);
+}
+
+static float subtract_min_sse2(float *outside, float *inside, size_t n)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 vmin4 = _mm_set1_ps(+INFINITY);
+    size_t i = 0;
+    for(; i+4 <= n; i += 4) {
+        __m128 in = _mm_max_ps(_mm_loadu_ps(inside+i), zero);
+        __m128 out = _mm_sub_ps(_mm_loadu_ps(outside+i), in);
+        _mm_storeu_ps(inside+i, in);
+        _mm_storeu_ps(outside+i, out);
+        vmin4 = _mm_min_ps(vmin4, out);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vmin4);
+    float vmin = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    return std::min(vmin, subtract_min_scalar(outside+i, inside+i, n-i));
+}
+
+static void normalize_sse2(const float *outside, float *data, float vmin, size_t n)
+{
+    const __m128 lo = _mm_set1_ps(-vmin);
+    const __m128 hi = _mm_set1_ps(vmin);
+    const __m128 range = _mm_set1_ps(2*vmin);
+    size_t i = 0;
+    for(; i+4 <= n; i += 4) {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(outside+i), lo), hi);
+        _mm_storeu_ps(data+i, _mm_div_ps(_mm_add_ps(v, hi), range));
+    }
+    normalize_scalar(outside+i, data+i, vmin, n-i);
+}
+
+// SSE2 has no gather; the taps are loaded one by one and the arithmetic
+// runs four output pixels at a time.
+static void filter_row_sse2(const float *src, const int *index, const float *weight, int taps,
+                            size_t n, float *dst)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i+4 <= n; i += 4) {
+        __m128 r = zero;
+        for(int k = 0; k < taps; k++) {
+            const int *ix = index + k*n + i;
+            __m128 v = _mm_setr_ps(src[ix[0]], src[ix[1]], src[ix[2]], src[ix[3]]);
+            __m128 t = _mm_mul_ps(_mm_loadu_ps(weight + k*n + i), v);
+            r = k ? _mm_add_ps(r, t) : t;
+        }
+        _mm_storeu_ps(dst+i, _mm_min_ps(_mm_max_ps(r, zero), one));
+    }
+    for(; i < n; ++i) {
+        dst[i] = filter_pixel_scalar(src, index, weight, taps, n, i);
+    }
+}
+
+static void blend_rows_sse2(const float * const *rows, const float *c, int taps, size_t n,
+                            float *dst)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i+4 <= n; i += 4) {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(c[0]), _mm_loadu_ps(rows[0]+i));
+        for(int k = 1; k < taps; k++) {
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(c[k]), _mm_loadu_ps(rows[k]+i)));
+        }
+        _mm_storeu_ps(dst+i, _mm_min_ps(_mm_max_ps(r, zero), one));
+    }
+    for(; i < n; ++i) {
+        dst[i] = blend_pixel_scalar(rows, c, taps, i);
+    }
+}
+
+static const dm_kernels sse2_kernels = {
+    "sse2", gradient_sse2, clamp_invert_sse2, subtract_min_sse2, normalize_sse2,
+    filter_row_sse2, blend_rows_sse2
+};
+
+#endif // DM_HAVE_SSE2
+
+#ifdef DM_HAVE_AVX2
+
+// --------------------------------------------------------------- AVX2 ---
+
+DM_TARGET_AVX2
+static void gradient_avx2(const float *img, int w, int h, float *gx, float *gy)
+{
+    const __m256 s2 = _mm256_set1_ps(dm_sqrt2);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for(int i = 1; i < h-1; i++) {
+        int j = 1;
+        for(; j+8 <= w-1; j += 8) {
+            int k = i*w + j;
+            __m256 ul = _mm256_loadu_ps(img+k-w-1), u = _mm256_loadu_ps(img+k-w), ur = _mm256_loadu_ps(img+k-w+1);
+            __m256 l  = _mm256_loadu_ps(img+k-1),   c = _mm256_loadu_ps(img+k),   r  = _mm256_loadu_ps(img+k+1);
+            __m256 dl = _mm256_loadu_ps(img+k+w-1), d = _mm256_loadu_ps(img+k+w), dr = _mm256_loadu_ps(img+k+w+1);
+            __m256 nul = _mm256_xor_ps(ul, sign);
+            __m256 vx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(nul, _mm256_mul_ps(s2, l)), dl), ur), _mm256_mul_ps(s2, r)), dr);
+            __m256 vy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(nul, _mm256_mul_ps(s2, u)), dl), ur), _mm256_mul_ps(s2, d)), dr);
+            __m256 gl = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+            __m256 nz = _mm256_cmp_ps(gl, zero, _CMP_GT_OQ);
+            __m256 len = _mm256_sqrt_ps(gl);
+            vx = _mm256_blendv_ps(vx, _mm256_div_ps(vx, len), nz);
+            vy = _mm256_blendv_ps(vy, _mm256_div_ps(vy, len), nz);
+            __m256 edge = _mm256_and_ps(_mm256_cmp_ps(c, zero, _CMP_GT_OQ), _mm256_cmp_ps(c, one, _CMP_LT_OQ));
+            _mm256_storeu_ps(gx+k, _mm256_and_ps(edge, vx));
+            _mm256_storeu_ps(gy+k, _mm256_and_ps(edge, vy));
+        }
+        gradient_row_scalar(img, w, i, j, w-1, gx, gy);
+    }
+}
+
+DM_TARGET_AVX2
+static void clamp_invert_avx2(float *outside, float *data, size_t n)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i+8 <= n; i += 8) {
+        _mm256_storeu_ps(outside+i, _mm256_max_ps(_mm256_loadu_ps(outside+i), zero));
+        _mm256_storeu_ps(data+i, _mm256_sub_ps(one, _mm256_loadu_ps(data+i)));
+    }
+    clamp_invert_scalar(outside+i, data+i, n-i);
+}
+
+DM_TARGET_AVX2
+static float subtract_min_avx2(float *outside, float *inside, size_t n)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 vmin8 = _mm256_set1_ps(+INFINITY);
+    size_t i = 0;
+    for(; i+8 <= n; i += 8) {
+        __m256 in = _mm256_max_ps(_mm256_loadu_ps(inside+i), zero);
+        __m256 out = _mm256_sub_ps(_mm256_loadu_ps(outside+i), in);
+        _mm256_storeu_ps(inside+i, in);
+        _mm256_storeu_ps(outside+i, out);
+        vmin8 = _mm256_min_ps(vmin8, out);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, vmin8);
+    float vmin = *std::min_element(lanes, lanes+8);
+    return std::min(vmin, subtract_min_scalar(outside+i, inside+i, n-i));
+}
+
+DM_TARGET_AVX2
+static void normalize_avx2(const float *outside, float *data, float vmin, size_t n)
+{
+    const __m256 lo = _mm256_set1_ps(-vmin);
+    const __m256 hi = _mm256_set1_ps(vmin);
+    const __m256 range = _mm256_set1_ps(2*vmin);
+    size_t i = 0;
+    for(; i+8 <= n; i += 8) {
+        __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(outside+i), lo), hi);
+        _mm256_storeu_ps(data+i, _mm256_div_ps(_mm256_add_ps(v, hi), range));
+    }
+    normalize_scalar(outside+i, data+i, vmin, n-i);
+}
+
+DM_TARGET_AVX2
+static void filter_row_avx2(const float *src, const int *index, const float *weight, int taps,
+                            size_t n, float *dst)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i+8 <= n; i += 8) {
+        __m256 r = zero;
+        for(int k = 0; k < taps; k++) {
+            __m256i ix = _mm256_loadu_si256((const __m256i *)(index + k*n + i));
+            __m256 t = _mm256_mul_ps(_mm256_loadu_ps(weight + k*n + i), _mm256_i32gather_ps(src, ix, 4));
+            r = k ? _mm256_add_ps(r, t) : t;
+        }
+        _mm256_storeu_ps(dst+i, _mm256_min_ps(_mm256_max_ps(r, zero), one));
+    }
+    for(; i < n; ++i) {
+        dst[i] = filter_pixel_scalar(src, index, weight, taps, n, i);
+    }
+}
+
+DM_TARGET_AVX2
+static void blend_rows_avx2(const float * const *rows, const float *c, int taps, size_t n,
+                            float *dst)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    size_t i = 0;
+    for(; i+8 <= n; i += 8) {
+        __m256 r = _mm256_mul_ps(_mm256_set1_ps(c[0]), _mm256_loadu_ps(rows[0]+i));
+        for(int k = 1; k < taps; k++) {
+            r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_set1_ps(c[k]), _mm256_loadu_ps(rows[k]+i)));
+        }
+        _mm256_storeu_ps(dst+i, _mm256_min_ps(_mm256_max_ps(r, zero), one));
+    }
+    for(; i < n; ++i) {
+        dst[i] = blend_pixel_scalar(rows, c, taps, i);
+    }
+}
+
+static const dm_kernels avx2_kernels = {
+    "avx2", gradient_avx2, clamp_invert_avx2, subtract_min_avx2, normalize_avx2,
+    filter_row_avx2, blend_rows_avx2
+};
+
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    if(regs[0] < 7) return false;
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    if(!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // DM_HAVE_AVX2
+
+static const dm_kernels & select_kernels()
+{
+    const dm_kernels *kernels = &scalar_kernels;
+#ifdef DM_HAVE_SSE2
+    kernels = &sse2_kernels;
+#endif
+#ifdef DM_HAVE_AVX2
+    if(cpu_has_avx2()) kernels = &avx2_kernels;
+#endif
+    return *kernels;
+}
+
+const dm_kernels & dm_get_kernels()
+{
+    static const dm_kernels & kernels = select_kernels();
+    return kernels;
+}
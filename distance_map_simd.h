@@ -0,0 +1,83 @@
+//
+//  distance_map_simd.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__distance_map_simd__
+#define __makeglfont__distance_map_simd__
+
+#include <cstddef>
+
+/**
+ * Vectorized kernels for the single-precision distance map.
+ * A table of function pointers is chosen once at runtime from the
+ * capabilities of the CPU (AVX2, SSE2, or plain scalar code). All
+ * variants produce the same results as the scalar loops they replace.
+ */
+struct dm_kernels
+{
+    const char *name;
+    
+    // computegradient() on float data. Unlike computegradient(), every
+    // interior pixel is written (non-edge pixels get 0), so gx and gy do
+    // not need to be cleared between calls. The one-pixel image border
+    // is left untouched and must be zero.
+    void (*gradient)(const float *img, int w, int h, float *gx, float *gy);
+    
+    // outside = max(outside, 0); data = 1 - data
+    void (*clamp_invert)(float *outside, float *data, size_t n);
+    
+    // inside = max(inside, 0); outside -= inside; returns min(outside)
+    float (*subtract_min)(float *outside, float *inside, size_t n);
+    
+    // data = (clamp(outside, -vmin, vmin) + vmin) / (2*vmin)
+    void (*normalize)(const float *outside, float *data, float vmin, size_t n);
+    
+    // Filter along a row, for resize(): for i < n,
+    // dst[i] = clamp(sum over k of weight[k*n+i]*src[index[k*n+i]], 0, 1),
+    // summed in order k = 0..taps-1.
+    void (*filter_row)(const float *src, const int *index, const float *weight, int taps,
+                       size_t n, float *dst);
+    
+    // Filter across rows: dst[i] = clamp(sum over k of c[k]*rows[k][i], 0, 1),
+    // summed in order k = 0..taps-1.
+    void (*blend_rows)(const float * const *rows, const float *c, int taps, size_t n, float *dst);
+};
+
+// Returns the fastest kernel table supported by this CPU.
+const dm_kernels & dm_get_kernels();
+
+#endif /* defined(__makeglfont__distance_map_simd__) */
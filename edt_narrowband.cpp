@@ -0,0 +1,174 @@
+//
+//  edt_narrowband.cpp
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "edtaa3func.h"
+#include "edt_narrowband.h"
+
+static const int NB_TILE = 16;
+
+enum nb_tile_class
+{
+    NB_EMPTY,  // every pixel is background
+    NB_FULL,   // every pixel is fully inside the object
+    NB_MIXED   // anything else
+};
+
+template <typename T, typename O>
+void edt_narrowband(T *img, T *gx, T *gy, int w, int h, O *distx, O *disty, T *dist,
+                    T spread)
+{
+    const T far_away = T(1000000.0);
+    const T epsilon = T(1e-3);
+    const int tw = (w + NB_TILE - 1) / NB_TILE;
+    const int th = (h + NB_TILE - 1) / NB_TILE;
+    
+    // Classify tiles
+    std::vector<unsigned char> tiles(tw*th);
+    for(int ty = 0; ty < th; ty++) {
+        for(int tx = 0; tx < tw; tx++) {
+            bool any_bg = false, any_full = false, any_gray = false;
+            int y1 = std::min(h, (ty+1)*NB_TILE), x1 = std::min(w, (tx+1)*NB_TILE);
+            for(int y = ty*NB_TILE; y < y1 && !any_gray; y++) {
+                for(int x = tx*NB_TILE; x < x1; x++) {
+                    T a = img[y*w + x];
+                    if(a <= 0) any_bg = true;
+                    else if(a >= 1) any_full = true;
+                    else { any_gray = true; break; }
+                }
+            }
+            tiles[ty*tw + tx] = (any_gray || (any_bg && any_full)) ? NB_MIXED
+                              : (any_full ? NB_FULL : NB_EMPTY);
+        }
+    }
+    
+    // Initialize distances and collect the edge pixels as seeds. Buckets
+    // hold pixels by integer distance, so propagation runs outward in
+    // (nearly) increasing distance order.
+    const int nbuckets = (int)std::ceil(spread) + 2;
+    std::vector< std::vector<int> > buckets(nbuckets);
+    
+    for(int ty = 0; ty < th; ty++) {
+        for(int tx = 0; tx < tw; tx++) {
+            int cls = tiles[ty*tw + tx];
+            bool uniform = (cls != NB_MIXED);
+            for(int ny = std::max(0, ty-1); uniform && ny <= std::min(th-1, ty+1); ny++) {
+                for(int nx = std::max(0, tx-1); nx <= std::min(tw-1, tx+1); nx++) {
+                    if(tiles[ny*tw + nx] != cls) { uniform = false; break; }
+                }
+            }
+            int y1 = std::min(h, (ty+1)*NB_TILE), x1 = std::min(w, (tx+1)*NB_TILE);
+            for(int y = ty*NB_TILE; y < y1; y++) {
+                for(int x = tx*NB_TILE; x < x1; x++) {
+                    int i = y*w + x;
+                    distx[i] = 0;
+                    disty[i] = 0;
+                    if(uniform) { // Skipped tile: no edges in or next to it
+                        dist[i] = (cls == NB_FULL) ? 0 : far_away;
+                        continue;
+                    }
+                    T a = img[i];
+                    if(a <= 0) {
+                        dist[i] = far_away;
+                        continue;
+                    }
+                    bool seed = (a < 1);
+                    if(a < 1) {
+                        dist[i] = edgedf(gx[i], gy[i], a); // Gradient-assisted estimate
+                    } else {
+                        dist[i] = 0; // Inside the object
+                        for(int dy = -1; dy <= 1 && !seed; dy++) {
+                            for(int dx = -1; dx <= 1; dx++) {
+                                int yy = y+dy, xx = x+dx;
+                                if(yy >= 0 && yy < h && xx >= 0 && xx < w && img[yy*w + xx] <= 0) {
+                                    seed = true;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                    if(seed) buckets[0].push_back(i);
+                }
+            }
+        }
+    }
+    
+    // Propagate the closest edge pixel outward from the seeds, stopping
+    // a little beyond the spread so everything inside it is exact.
+    const T limit = spread + 2;
+    for(int b = 0; b < nbuckets; b++) {
+        for(size_t n = 0; n < buckets[b].size(); n++) {
+            int i = buckets[b][n];
+            if(b > 0 && dist[i] < b) continue; // Stale: reached again from a closer edge
+            int y = i / w, x = i - y*w;
+            int cdistx = distx[i], cdisty = disty[i];
+            for(int dy = -1; dy <= 1; dy++) {
+                for(int dx = -1; dx <= 1; dx++) {
+                    int yy = y+dy, xx = x+dx;
+                    if((dx == 0 && dy == 0) || yy < 0 || yy >= h || xx < 0 || xx >= w) continue;
+                    int j = yy*w + xx;
+                    T olddist = dist[j];
+                    if(olddist <= 0) continue; // No need to update further
+                    int newdistx = cdistx + dx;
+                    int newdisty = cdisty + dy;
+                    T newdist = distaa3(img, gx, gy, w, i, cdistx, cdisty, newdistx, newdisty);
+                    if(newdist < olddist-epsilon && newdist < limit) {
+                        distx[j] = newdistx;
+                        disty[j] = newdisty;
+                        dist[j] = newdist;
+                        int nb = std::max(b, (int)newdist);
+                        buckets[std::min(nb, nbuckets-1)].push_back(j);
+                    }
+                }
+            }
+        }
+        std::vector<int>().swap(buckets[b]);
+    }
+}
+
+template void edt_narrowband<float, short>(float *img, float *gx, float *gy, int w, int h,
+                                           short *distx, short *disty, float *dist, float spread);
+template void edt_narrowband<float, int>(float *img, float *gx, float *gy, int w, int h,
+                                         int *distx, int *disty, float *dist, float spread);
+template void edt_narrowband<double, short>(double *img, double *gx, double *gy, int w, int h,
+                                            short *distx, short *disty, double *dist, double spread);
+template void edt_narrowband<double, int>(double *img, double *gx, double *gy, int w, int h,
+                                          int *distx, int *disty, double *dist, double spread);
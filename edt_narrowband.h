@@ -0,0 +1,62 @@
+//
+//  edt_narrowband.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__edt_narrowband__
+#define __makeglfont__edt_narrowband__
+
+/*
+ * edt_narrowband()
+ *
+ * Band-limited version of edtaa3(), with the same arguments and outputs,
+ * that only computes distances up to "spread" pixels from the edge.
+ * Pixels farther away keep the "very far" value (1000000) and are expected
+ * to be clamped by the caller.
+ *
+ * Distances are propagated outward from the edge pixels only (gray
+ * pixels, and object pixels next to the background) in order of
+ * increasing distance, and propagation stops at the spread. The image is
+ * classified in tiles first: tiles that are entirely background or
+ * entirely object, with neighbors of the same kind, are filled without
+ * looking for edges. The cost of the transform is proportional to the
+ * outline length times the spread, rather than to the image area.
+ */
+template <typename T, typename O>
+void edt_narrowband(T *img, T *gx, T *gy, int w, int h, O *distx, O *disty, T *dist,
+                    T spread);
+
+#endif /* defined(__makeglfont__edt_narrowband__) */
@@ -0,0 +1,429 @@
+//
+//  edt_sampled.cpp
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "edtaa3func.h"
+#include "edt_sampled.h"
+#include "span_raster.h"
+
+static const int SP_CELL = 8; // bucket size in pixels
+
+// An edge pixel: position, coverage (as seen by its half of the
+// transform) and gradient.
+template <typename T>
+struct sp_edge
+{
+    int x, y;
+    T a, gx, gy;
+};
+
+// Edge pixels bucketed by position, stored bucket after bucket.
+template <typename T>
+struct sp_grid
+{
+    int gw, gh;
+    std::vector<int> start; // first edge of each bucket, plus an end marker
+    std::vector< sp_edge<T> > edges;
+    std::vector<int> ring;  // rings around each bucket that hold no edges
+    
+    void build(std::vector< sp_edge<T> > const & list, int w, int h)
+    {
+        gw = (w + SP_CELL - 1) / SP_CELL;
+        gh = (h + SP_CELL - 1) / SP_CELL;
+        start.assign(gw*gh + 1, 0);
+        for(size_t k = 0; k < list.size(); k++) {
+            start[(list[k].y/SP_CELL)*gw + list[k].x/SP_CELL + 1]++;
+        }
+        for(int c = 0; c < gw*gh; c++) {
+            start[c+1] += start[c];
+        }
+        edges.resize(list.size());
+        std::vector<int> fill(start.begin(), start.end()-1);
+        for(size_t k = 0; k < list.size(); k++) {
+            edges[fill[(list[k].y/SP_CELL)*gw + list[k].x/SP_CELL]++] = list[k];
+        }
+        
+        // Chessboard distance transform of the occupied buckets: ring[c]
+        // is the ring index of the nearest occupied bucket, so the rings
+        // inside it can be skipped.
+        const int far_away = gw + gh;
+        ring.assign(gw*gh, far_away);
+        for(int c = 0; c < gw*gh; c++) {
+            if(start[c+1] > start[c]) ring[c] = 0;
+        }
+        for(int by = 0; by < gh; by++) {
+            for(int bx = 0; bx < gw; bx++) {
+                int & d = ring[by*gw + bx];
+                if(bx > 0) d = std::min(d, ring[by*gw + bx-1] + 1);
+                if(by > 0) {
+                    for(int nx = std::max(0, bx-1); nx <= std::min(gw-1, bx+1); nx++) {
+                        d = std::min(d, ring[(by-1)*gw + nx] + 1);
+                    }
+                }
+            }
+        }
+        for(int by = gh-1; by >= 0; by--) {
+            for(int bx = gw-1; bx >= 0; bx--) {
+                int & d = ring[by*gw + bx];
+                if(bx < gw-1) d = std::min(d, ring[by*gw + bx+1] + 1);
+                if(by < gh-1) {
+                    for(int nx = std::max(0, bx-1); nx <= std::min(gw-1, bx+1); nx++) {
+                        d = std::min(d, ring[(by+1)*gw + nx] + 1);
+                    }
+                }
+            }
+        }
+    }
+    
+    // distaa3() from pixel (x,y) to edge pixel k.
+    inline T distance(int x, int y, int k) const
+    {
+        const sp_edge<T> & e = edges[k];
+        int xi = x - e.x, yi = y - e.y;
+        if(xi == 0 && yi == 0) {
+            return edgedf(e.gx, e.gy, e.a); // Use local gradient only at edges
+        }
+        return std::sqrt(T(xi)*xi + T(yi)*yi) + edgedf(T(xi), T(yi), e.a);
+    }
+    
+    // distaa3() distance from pixel (x,y) to the nearest edge pixel, or
+    // limit if there is none closer. hint is the nearest edge pixel of
+    // the previous query (or -1); neighboring samples mostly share it, and
+    // starting from it rules out most buckets right away. It is updated
+    // to this query's nearest edge pixel.
+    T nearest(int x, int y, T limit, int & hint) const
+    {
+        T best = limit;
+        if(hint >= 0) {
+            best = std::min(best, distance(x, y, hint));
+        }
+        // The sub-pixel term of distaa3() is within (-1,1), so an edge pixel
+        // whose center is farther than best+1 cannot win.
+        T reach = best + 1;
+        long reach2 = (long)(reach*reach) + 1;
+        const int cx = x / SP_CELL, cy = y / SP_CELL;
+        const int rmax = std::max(gw, gh);
+        for(int r = ring[cy*gw + cx]; r <= rmax; r++) {
+            // Every pixel in ring r is at least (r-1)*SP_CELL+1 pixels away.
+            if(r > 0 && T((r-1)*SP_CELL + 1) > reach) break;
+            for(int by = cy-r; by <= cy+r; by++) {
+                if(by < 0 || by >= gh) continue;
+                const int step = (by == cy-r || by == cy+r) ? 1 : 2*r;
+                for(int bx = cx-r; bx <= cx+r; bx += step) {
+                    if(bx < 0 || bx >= gw) continue;
+                    // Skip buckets whose nearest pixel is out of reach.
+                    int ox = std::max(0, std::max(bx*SP_CELL - x, x - (bx*SP_CELL + SP_CELL-1)));
+                    int oy = std::max(0, std::max(by*SP_CELL - y, y - (by*SP_CELL + SP_CELL-1)));
+                    if((long)ox*ox + (long)oy*oy > reach2) continue;
+                    for(int k = start[by*gw + bx]; k < start[by*gw + bx + 1]; k++) {
+                        int xi = x - edges[k].x, yi = y - edges[k].y;
+                        if((long)xi*xi + (long)yi*yi > reach2) continue;
+                        T d = distance(x, y, k);
+                        if(d < best) {
+                            best = d;
+                            hint = k;
+                            reach = best + 1;
+                            reach2 = (long)(reach*reach) + 1;
+                        }
+                    }
+                }
+            }
+        }
+        return best;
+    }
+};
+
+// The bipolar field at pixel (x,y), whose coverage is a.
+template <typename T>
+static inline T sp_sample(sp_grid<T> const & outer_grid, sp_grid<T> const & inner_grid,
+                          int x, int y, T a, T limit, int & outer_hint, int & inner_hint)
+{
+    T outside = (a >= 1) ? 0 : outer_grid.nearest(x, y, limit, outer_hint);
+    T inside = (a <= 0) ? 0 : inner_grid.nearest(x, y, limit, inner_hint);
+    if(outside < 0) outside = 0;
+    if(inside < 0) inside = 0;
+    return outside - inside;
+}
+
+template <typename T>
+void edt_sampled(T *img, T *gx, T *gy, int w, int h,
+                 std::vector<int> const & xs, std::vector<int> const & ys,
+                 T limit, T *out)
+{
+    // Collect the edge pixels of both halves. The nearest pixel of the
+    // object to a background pixel is gray or next to the background
+    // (and the other way round), so no other pixels are needed. Pixels are
+    // classed as background (0), gray (1) or full (2); the smallest and
+    // largest class in each 3x3 neighborhood come from running the
+    // horizontal minimum and maximum of three rows.
+    std::vector< sp_edge<T> > outer, inner;
+    std::vector<unsigned char> cls(3*w), hmin(3*w), hmax(3*w);
+    for(int y = 0; y <= h; y++) {
+        if(y < h) {
+            unsigned char *c = &cls[(y%3)*w], *mn = &hmin[(y%3)*w], *mx = &hmax[(y%3)*w];
+            for(int x = 0; x < w; x++) {
+                T a = img[y*w + x];
+                c[x] = (a <= 0) ? 0 : (a >= 1 ? 2 : 1);
+            }
+            for(int x = 0; x < w; x++) {
+                unsigned char l = c[x > 0 ? x-1 : x], r = c[x < w-1 ? x+1 : x];
+                mn[x] = std::min(c[x], std::min(l, r));
+                mx[x] = std::max(c[x], std::max(l, r));
+            }
+        }
+        // Row y-1 now has both of its neighbor rows.
+        int yc = y-1;
+        if(yc < 0) continue;
+        const unsigned char *c = &cls[(yc%3)*w];
+        const int ya = (yc > 0 ? yc-1 : yc) % 3, yb = (yc < h-1 ? yc+1 : yc) % 3;
+        for(int x = 0; x < w; x++) {
+            int i = yc*w + x;
+            if(c[x] == 1) {
+                sp_edge<T> e = { x, yc, img[i], gx[i], gy[i] };
+                outer.push_back(e);
+                e.a = 1 - e.a;
+                inner.push_back(e);
+            } else if(c[x] == 2) {
+                if(std::min(hmin[(yc%3)*w + x], std::min(hmin[ya*w + x], hmin[yb*w + x])) == 0) {
+                    sp_edge<T> e = { x, yc, T(1), gx[i], gy[i] };
+                    outer.push_back(e);
+                }
+            } else {
+                if(std::max(hmax[(yc%3)*w + x], std::max(hmax[ya*w + x], hmax[yb*w + x])) == 2) {
+                    sp_edge<T> e = { x, yc, T(1), gx[i], gy[i] };
+                    inner.push_back(e);
+                }
+            }
+        }
+    }
+    
+    sp_grid<T> outer_grid, inner_grid;
+    outer_grid.build(outer, w, h);
+    inner_grid.build(inner, w, h);
+    
+    int outer_hint = -1, inner_hint = -1;
+    for(size_t j = 0; j < ys.size(); j++) {
+        for(size_t k = 0; k < xs.size(); k++) {
+            int x = xs[k], y = ys[j];
+            out[j*xs.size() + k] = sp_sample(outer_grid, inner_grid, x, y, img[y*w + x], limit,
+                                             outer_hint, inner_hint);
+        }
+    }
+}
+
+// A half-open range [x0,x1) of pixels in a row.
+struct sp_interval
+{
+    int x0, x1;
+};
+
+// The empty and the fully covered pixels of row y, as sorted ranges.
+static void sp_row_classes(span_raster const & img, int y,
+                           std::vector<sp_interval> & empty, std::vector<sp_interval> & full)
+{
+    empty.clear();
+    full.clear();
+    int x = 0;
+    for(int k = img.row_start[y]; k < img.row_start[y+1]; k++) {
+        const span_run & r = img.runs[k];
+        if(r.x > x) {
+            sp_interval e = { x, r.x };
+            empty.push_back(e);
+        }
+        if(r.coverage == 255) {
+            if(!full.empty() && full.back().x1 == r.x) {
+                full.back().x1 = r.x + r.len;
+            } else {
+                sp_interval f = { r.x, r.x + r.len };
+                full.push_back(f);
+            }
+        }
+        x = r.x + r.len;
+    }
+    if(x < img.width) {
+        sp_interval e = { x, img.width };
+        empty.push_back(e);
+    }
+}
+
+// The pixels within one pixel of a range in one of three rows (the 3x3
+// neighborhoods that touch them), as sorted disjoint ranges.
+static void sp_dilate3(const std::vector<sp_interval> * rows[3], int w,
+                       std::vector<sp_interval> & out)
+{
+    out.clear();
+    for(int r = 0; r < 3; r++) {
+        for(size_t k = 0; k < rows[r]->size(); k++) {
+            sp_interval d = { std::max(0, (*rows[r])[k].x0 - 1), std::min(w, (*rows[r])[k].x1 + 1) };
+            out.push_back(d);
+        }
+    }
+    std::sort(out.begin(), out.end(),
+              [](sp_interval const & a, sp_interval const & b) { return a.x0 < b.x0; });
+    size_t n = 0;
+    for(size_t k = 0; k < out.size(); k++) {
+        if(n > 0 && out[k].x0 <= out[n-1].x1) {
+            out[n-1].x1 = std::max(out[n-1].x1, out[k].x1);
+        } else {
+            out[n++] = out[k];
+        }
+    }
+    out.resize(n);
+}
+
+// Calls fn(x) for every pixel in both a and b.
+template <typename F>
+static void sp_intersect(std::vector<sp_interval> const & a, std::vector<sp_interval> const & b, F fn)
+{
+    size_t i = 0, j = 0;
+    while(i < a.size() && j < b.size()) {
+        int x0 = std::max(a[i].x0, b[j].x0), x1 = std::min(a[i].x1, b[j].x1);
+        for(int x = x0; x < x1; x++) {
+            fn(x);
+        }
+        if(a[i].x1 < b[j].x1) i++; else j++;
+    }
+}
+
+template <typename T>
+void edt_sampled_spans(span_raster const & img,
+                       std::vector<int> const & xs, std::vector<int> const & ys,
+                       T limit, T *out)
+{
+    const int w = img.width, h = img.height;
+    const T SQRT2 = T(1.4142136);
+    
+    // The same edge pixels as edt_sampled() collects, found by comparing
+    // ranges of rows rather than pixels. Only the gray pixels are looked at
+    // one by one, to take their gradient.
+    std::vector< sp_edge<T> > outer, inner;
+    std::vector<sp_interval> empty[3], full[3], near_empty, near_full;
+    std::vector<unsigned char> cov[3];
+    for(int y = 0; y < h; y++) {
+        const int rows[3] = { std::max(y-1, 0), y, std::min(y+1, h-1) };
+        if(y == 0) {
+            sp_row_classes(img, 0, empty[0], full[0]);
+            if(h > 1) sp_row_classes(img, 1, empty[1], full[1]);
+        } else if(y+1 < h) {
+            sp_row_classes(img, y+1, empty[(y+1)%3], full[(y+1)%3]);
+        }
+        const std::vector<sp_interval> * e3[3], * f3[3];
+        for(int r = 0; r < 3; r++) {
+            e3[r] = &empty[rows[r]%3];
+            f3[r] = &full[rows[r]%3];
+        }
+        sp_dilate3(e3, w, near_empty);
+        sp_dilate3(f3, w, near_full);
+        
+        // Fully covered pixels next to an empty one, and the other way round.
+        sp_intersect(full[y%3], near_empty, [&](int x) {
+            sp_edge<T> e = { x, y, T(1), T(0), T(0) };
+            outer.push_back(e);
+        });
+        sp_intersect(empty[y%3], near_full, [&](int x) {
+            sp_edge<T> e = { x, y, T(1), T(0), T(0) };
+            inner.push_back(e);
+        });
+        
+        // Gray pixels, with computegradient()'s gradient.
+        for(int k = img.row_start[y]; k < img.row_start[y+1]; k++) {
+            const span_run & r = img.runs[k];
+            if(r.coverage == 255) continue;
+            const int x0 = r.x - 1, n = r.len + 2;
+            for(int j = 0; j < 3; j++) {
+                cov[j].resize(n);
+                img.row_coverage(y-1+j, x0, x0 + n, cov[j].data());
+            }
+            for(int x = r.x; x < r.x + r.len; x++) {
+                const int c = x - x0;
+                T g_x = 0, g_y = 0;
+                if(x > 0 && x < w-1 && y > 0 && y < h-1) {
+                    const T ul = T(cov[0][c-1])/T(255), u = T(cov[0][c])/T(255), ur = T(cov[0][c+1])/T(255);
+                    const T l = T(cov[1][c-1])/T(255), rt = T(cov[1][c+1])/T(255);
+                    const T dl = T(cov[2][c-1])/T(255), d = T(cov[2][c])/T(255), dr = T(cov[2][c+1])/T(255);
+                    g_x = -ul - SQRT2*l - dl + ur + SQRT2*rt + dr;
+                    g_y = -ul - SQRT2*u - dl + ur + SQRT2*d + dr;
+                    T glength = g_x*g_x + g_y*g_y;
+                    if(glength > 0) {
+                        glength = std::sqrt(glength);
+                        g_x = g_x/glength;
+                        g_y = g_y/glength;
+                    }
+                }
+                sp_edge<T> e = { x, y, T(r.coverage)/T(255), g_x, g_y };
+                outer.push_back(e);
+                e.a = 1 - e.a;
+                inner.push_back(e);
+            }
+        }
+    }
+    
+    sp_grid<T> outer_grid, inner_grid;
+    outer_grid.build(outer, w, h);
+    inner_grid.build(inner, w, h);
+    
+    int outer_hint = -1, inner_hint = -1;
+    for(size_t j = 0; j < ys.size(); j++) {
+        const int y = ys[j];
+        const span_run *run = img.runs.data() + img.row_start[y];
+        const span_run *end = img.runs.data() + img.row_start[y+1];
+        for(size_t k = 0; k < xs.size(); k++) {
+            const int x = xs[k];
+            while(run != end && run->x + run->len <= x) ++run;
+            T a = (run != end && run->x <= x) ? T(run->coverage)/T(255) : T(0);
+            out[j*xs.size() + k] = sp_sample(outer_grid, inner_grid, x, y, a, limit,
+                                             outer_hint, inner_hint);
+        }
+    }
+}
+
+template void edt_sampled<float>(float *img, float *gx, float *gy, int w, int h,
+                                 std::vector<int> const & xs, std::vector<int> const & ys,
+                                 float limit, float *out);
+template void edt_sampled<double>(double *img, double *gx, double *gy, int w, int h,
+                                  std::vector<int> const & xs, std::vector<int> const & ys,
+                                  double limit, double *out);
+template void edt_sampled_spans<float>(span_raster const & img,
+                                       std::vector<int> const & xs, std::vector<int> const & ys,
+                                       float limit, float *out);
+template void edt_sampled_spans<double>(span_raster const & img,
+                                        std::vector<int> const & xs, std::vector<int> const & ys,
+                                        double limit, double *out);
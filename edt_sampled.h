@@ -0,0 +1,81 @@
+//
+//  edt_sampled.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+
+#ifndef __makeglfont__edt_sampled__
+#define __makeglfont__edt_sampled__
+
+#include <vector>
+
+struct span_raster;
+
+/*
+ * edt_sampled()
+ *
+ * Evaluates the bipolar distance field of an anti-aliased image (outside
+ * minus inside distance, each clamped to positive values, as
+ * make_distance_map() computes it before normalizing) at a sparse set of
+ * pixels only: every combination of a column in xs with a row in ys. out
+ * receives xs.size()*ys.size() values, row by row.
+ *
+ * The edge pixels of the image (gray pixels, and fully covered or empty
+ * pixels next to the opposite kind) are sorted into a bucket grid once.
+ * Each sample then looks for its nearest edge pixel under the edtaa3()
+ * metric (distaa3()), ring by ring outward from its own bucket, so the
+ * cost is proportional to the number of samples rather than to the image
+ * area. Distances beyond "limit" are not searched for; they come back as
+ * +-limit.
+ */
+template <typename T>
+void edt_sampled(T *img, T *gx, T *gy, int w, int h,
+                 std::vector<int> const & xs, std::vector<int> const & ys,
+                 T limit, T *out);
+
+/*
+ * edt_sampled() for an image stored as runs (span_raster.h). The edge
+ * pixels are found from the runs of neighboring rows, and only the gray
+ * ones are expanded to take their gradient, so no per-pixel image or
+ * gradient buffer is needed. The samples match edt_sampled() on the
+ * equivalent bitmap (coverage/255) with its computegradient() gradient.
+ */
+template <typename T>
+void edt_sampled_spans(span_raster const & img,
+                       std::vector<int> const & xs, std::vector<int> const & ys,
+                       T limit, T *out);
+
+#endif /* defined(__makeglfont__edt_sampled__) */
@@ -0,0 +1,173 @@
+//
+//  edt_separable.cpp
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "edtaa3func.h"
+#include "edt_separable.h"
+#include "parallel.h"
+
+// No object pixel in this column: the largest offset of type O.
+template <typename O>
+static inline O edt_none() { return std::numeric_limits<O>::max(); }
+
+/*
+ * Column pass: for every pixel, the signed vertical offset (y - seed_y)
+ * to the closest object pixel in the same column, or edt_none().
+ * The columns x0..x1 are swept a row at a time to stay cache friendly.
+ */
+template <typename T, typename O>
+static void edt_columns(const T *img, int w, int h, int x0, int x1, O *disty)
+{
+    const O EDT_NONE = edt_none<O>();
+    // Top to bottom: closest object pixel above (or at) each pixel
+    for(int y = 0; y < h; y++) {
+        const T *row = img + y*w;
+        O *d = disty + y*w;
+        for(int x = x0; x < x1; x++) {
+            if(row[x] > 0) {
+                d[x] = 0;
+            } else if(y > 0 && d[x-w] != EDT_NONE) {
+                d[x] = d[x-w] + 1;
+            } else {
+                d[x] = EDT_NONE;
+            }
+        }
+    }
+    // Bottom to top: keep the closer of that and the one below
+    for(int y = h-2; y >= 0; y--) {
+        O *d = disty + y*w;
+        for(int x = x0; x < x1; x++) {
+            O below = d[x+w];
+            if(below == EDT_NONE) continue;
+            int candidate = below - 1;
+            if(d[x] == EDT_NONE || -candidate < d[x]) {
+                d[x] = (O)candidate;
+            }
+        }
+    }
+}
+
+/*
+ * Row pass: lower envelope of the parabolas (x-q)^2 + dy(q)^2 along a
+ * row, then the anti-aliased distance to the closest object pixel.
+ */
+template <typename T, typename O>
+static void edt_rows(T *img, T *gx, T *gy, int w, int h, int y0, int y1,
+                     O *distx, O *disty, T *dist)
+{
+    const O EDT_NONE = edt_none<O>();
+    std::vector<int> v(w);       // parabola vertices in the lower envelope
+    std::vector<float> z(w+1);   // boundaries between envelope segments
+    std::vector<O> col(w);       // column offsets of this row (overwritten below)
+    
+    for(int y = y0; y < y1; y++) {
+        O *dy_row = disty + y*w;
+        std::copy(dy_row, dy_row + w, col.begin());
+        
+        int k = -1;
+        for(int q = 0; q < w; q++) {
+            if(col[q] == EDT_NONE) continue;
+            float fq = (float)col[q]*col[q] + (float)q*q;
+            float s = -INFINITY;
+            while(k >= 0) {
+                int p = v[k];
+                float fp = (float)col[p]*col[p] + (float)p*p;
+                s = (fq - fp) / (2.0f*(q - p));
+                if(s > z[k]) break;
+                k--;
+            }
+            k++;
+            v[k] = q;
+            z[k] = (k == 0) ? -INFINITY : s;
+            z[k+1] = +INFINITY;
+        }
+        
+        int seg = 0;
+        for(int x = 0; x < w; x++) {
+            int i = y*w + x;
+            distx[i] = 0;
+            disty[i] = 0;
+            if(img[i] >= 1) {
+                dist[i] = 0; // Inside the object
+                continue;
+            }
+            if(img[i] > 0) {
+                dist[i] = edgedf(gx[i], gy[i], img[i]); // Gradient-assisted estimate
+                continue;
+            }
+            if(k < 0) {
+                dist[i] = T(1000000.0); // No object pixel anywhere in the image
+                continue;
+            }
+            while(z[seg+1] < x) seg++;
+            int q = v[seg];
+            int dx = x - q;
+            int dy = col[q];
+            T a = img[(y-dy)*w + q];
+            if(a > 1) a = 1;
+            distx[i] = (O)dx;
+            disty[i] = (O)dy;
+            T di = std::sqrt((T)(dx*dx + dy*dy));
+            dist[i] = di + edgedf((T)dx, (T)dy, a);
+        }
+    }
+}
+
+template <typename T, typename O>
+void edt_separable(T *img, T *gx, T *gy, int w, int h, O *distx, O *disty, T *dist,
+                   int threads)
+{
+    parallel_for(0, w, threads, [=](int x0, int x1) {
+        edt_columns(img, w, h, x0, x1, disty);
+    });
+    parallel_for(0, h, threads, [=](int y0, int y1) {
+        edt_rows(img, gx, gy, w, h, y0, y1, distx, disty, dist);
+    });
+}
+
+template void edt_separable<float, short>(float *img, float *gx, float *gy, int w, int h,
+                                          short *distx, short *disty, float *dist, int threads);
+template void edt_separable<float, int>(float *img, float *gx, float *gy, int w, int h,
+                                        int *distx, int *disty, float *dist, int threads);
+template void edt_separable<double, short>(double *img, double *gx, double *gy, int w, int h,
+                                           short *distx, short *disty, double *dist, int threads);
+template void edt_separable<double, int>(double *img, double *gx, double *gy, int w, int h,
+                                         int *distx, int *disty, double *dist, int threads);
@@ -0,0 +1,66 @@
+//
+//  edt_separable.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__edt_separable__
+#define __makeglfont__edt_separable__
+
+/*
+ * edt_separable()
+ *
+ * Exact linear-time Euclidean distance transform after Felzenszwalb and
+ * Huttenlocher ("Distance Transforms of Sampled Functions", 2004), used as
+ * a drop-in replacement for edtaa3(). Takes the same arguments and
+ * produces the same outputs: positive pixels are object pixels, distx and
+ * disty receive the offset from each pixel to its closest object pixel,
+ * and dist the anti-aliased distance.
+ *
+ * The transform makes one pass down the columns and one pass along the
+ * rows, each with a fixed cost per pixel. Columns (and rows) are
+ * independent and are split across "threads" workers (0 = all cores).
+ * The closest object pixel is picked by integer Euclidean distance and
+ * the gray-level edge correction of edtaa3 (edgedf) is then applied to
+ * it, so results differ from edtaa3 only where the two metrics disagree
+ * about the closest edge pixel.
+ *
+ * O is the offset type, as for edtaa3(); its largest value is reserved.
+ */
+template <typename T, typename O>
+void edt_separable(T *img, T *gx, T *gy, int w, int h, O *distx, O *disty, T *dist,
+                   int threads);
+
+#endif /* defined(__makeglfont__edt_separable__) */
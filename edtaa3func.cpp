@@ -52,17 +52,21 @@
  */
 
 #include <cmath>
+#include <algorithm>
+
+#include "edtaa3func.h"
 
 /*
  * Compute the local gradient at edge pixels using convolution filters.
  * The gradient is computed only at edge pixels. At other places in the
  * image, it is never used, and it's mostly zero anyway.
  */
-void computegradient(double *img, int w, int h, double *gx, double *gy)
+template <typename T>
+void computegradient(T *img, int w, int h, T *gx, T *gy)
 {
     int i,j,k; // ,p,q;
-    double glength ; //, phi, phiscaled, ascaled, errsign, pfrac, qfrac, err0, err1, err;
-#define SQRT2 1.4142136
+    T glength ; //, phi, phiscaled, ascaled, errsign, pfrac, qfrac, err0, err1, err;
+    const T SQRT2 = T(1.4142136);
     for(i = 1; i < h-1; i++) { // Avoid edges where the kernels would spill over
         for(j = 1; j < w-1; j++) {
             k = i*w + j;
@@ -70,7 +74,7 @@ void computegradient(double *img, int w, int h, double *gx, double *gy)
                 gx[k] = -img[k-w-1] - SQRT2*img[k-1] - img[k+w-1] + img[k-w+1] + SQRT2*img[k+1] + img[k+w+1];
                 gy[k] = -img[k-w-1] - SQRT2*img[k-w] - img[k+w-1] + img[k-w+1] + SQRT2*img[k+w] + img[k+w+1];
                 glength = gx[k]*gx[k] + gy[k]*gy[k];
-                if(glength > 0.0) { // Avoid division by zero
+                if(glength > 0) { // Avoid division by zero
                     glength = std::sqrt(glength);
                     gx[k]=gx[k]/glength;
                     gy[k]=gy[k]/glength;
@@ -92,14 +96,15 @@ void computegradient(double *img, int w, int h, double *gx, double *gy)
  * accuracy at and near edges, and reduces the error even at distant pixels
  * provided that the gradient direction is accurately estimated.
  */
-double edgedf(double gx, double gy, double a)
+template <typename T>
+T edgedf(T gx, T gy, T a)
 {
-    double df, glength, temp, a1;
+    T df, glength, temp, a1;
     
     if ((gx == 0) || (gy == 0)) { // Either A) gu or gv are zero, or B) both
-        df = 0.5-a;  // Linear approximation is A) correct or B) a fair guess
+        df = T(0.5)-a;  // Linear approximation is A) correct or B) a fair guess
     } else {
-        glength = sqrt(gx*gx + gy*gy);
+        glength = std::sqrt(gx*gx + gy*gy);
         if(glength>0) {
             gx = gx/glength;
             gy = gy/glength;
@@ -108,42 +113,41 @@ double edgedf(double gx, double gy, double a)
          * so move to first octant (gx>=0, gy>=0, gx>=gy) to
          * avoid handling all possible edge directions.
          */
-        gx = fabs(gx);
-        gy = fabs(gy);
+        gx = std::fabs(gx);
+        gy = std::fabs(gy);
         if(gx<gy) {
             temp = gx;
             gx = gy;
             gy = temp;
         }
-        a1 = 0.5*gy/gx;
+        a1 = T(0.5)*gy/gx;
         if (a < a1) { // 0 <= a < a1
-            df = 0.5*(gx + gy) - sqrt(2.0*gx*gy*a);
-        } else if (a < (1.0-a1)) { // a1 <= a <= 1-a1
-            df = (0.5-a)*gx;
+            df = T(0.5)*(gx + gy) - std::sqrt(T(2)*gx*gy*a);
+        } else if (a < (T(1)-a1)) { // a1 <= a <= 1-a1
+            df = (T(0.5)-a)*gx;
         } else { // 1-a1 < a <= 1
-            df = -0.5*(gx + gy) + sqrt(2.0*gx*gy*(1.0-a));
+            df = T(-0.5)*(gx + gy) + std::sqrt(T(2)*gx*gy*(T(1)-a));
         }
     }
     return df;
 }
 
-double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc, int yc, int xi, int yi)
+/*
+ * The part of distaa3() that follows the lookup of the edge pixel: its
+ * coverage a and gradient (gx,gy), and the offset (xi,yi) to it.
+ */
+template <typename T>
+static inline T distaa3_edge(T a, T gx, T gy, int xi, int yi)
 {
-    double di, df, dx, dy, gx, gy, a;
-    int closest;
-    
-    closest = c-xc-yc*w; // Index to the edge pixel pointed to from c
-    a = img[closest];    // Grayscale value at the edge pixel
-    gx = gximg[closest]; // X gradient component at the edge pixel
-    gy = gyimg[closest]; // Y gradient component at the edge pixel
+    T di, df, dx, dy;
     
-    if(a > 1.0) a = 1.0;
-    if(a < 0.0) a = 0.0; // Clip grayscale values outside the range [0,1]
-    if(a == 0.0) return 1000000.0; // Not an object pixel, return "very far" ("don't know yet")
+    if(a > 1) a = 1;
+    if(a < 0) a = 0; // Clip grayscale values outside the range [0,1]
+    if(a == 0) return T(1000000.0); // Not an object pixel, return "very far" ("don't know yet")
     
-    dx = (double)xi;
-    dy = (double)yi;
-    di = sqrt(dx*dx + dy*dy); // Length of integer vector, like a traditional EDT
+    dx = (T)xi;
+    dy = (T)yi;
+    di = std::sqrt(dx*dx + dy*dy); // Length of integer vector, like a traditional EDT
     if(di==0) { // Use local gradient only at edges
         // Estimate based on local gradient only
         df = edgedf(gx, gy, a);
@@ -154,18 +158,28 @@ double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc,
     return di + df; // Same metric as edtaa2, except at edges (where di=0)
 }
 
+template <typename T>
+T distaa3(T *img, T *gximg, T *gyimg, int w, int c, int xc, int yc, int xi, int yi)
+{
+    int closest = c-xc-yc*w; // Index to the edge pixel pointed to from c
+    
+    // Grayscale value and gradient at the edge pixel
+    return distaa3_edge(img[closest], gximg[closest], gyimg[closest], xi, yi);
+}
+
 // Shorthand macro: add ubiquitous parameters dist, gx, gy, img and w and call distaa3()
 #define DISTAA(c,xc,yc,xi,yi) (distaa3(img, gx, gy, w, c, xc, yc, xi, yi))
 
-void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, short *disty, double *dist)
+template <typename T, typename O>
+void edtaa3(T *img, T *gx, T *gy, int w, int h, O *distx, O *disty, T *dist)
 {
     int x, y, i, c;
     int offset_u, offset_ur, offset_r, offset_rd,
     offset_d, offset_dl, offset_l, offset_lu;
-    double olddist, newdist;
+    T olddist, newdist;
     int cdistx, cdisty, newdistx, newdisty;
     int changed;
-    double epsilon = 1e-3;
+    const T epsilon = T(1e-3);
     
     /* Initialize index offsets for the current image width */
     offset_u = -w;
@@ -181,15 +195,15 @@ void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, sho
     for(i=0; i<w*h; i++) {
         distx[i] = 0; // At first, all pixels point to
         disty[i] = 0; // themselves as the closest known.
-        if(img[i] <= 0.0)
+        if(img[i] <= 0)
         {
-            dist[i]= 1000000.0; // Big value, means "not set yet"
+            dist[i]= T(1000000.0); // Big value, means "not set yet"
         }
-        else if (img[i]<1.0) {
+        else if (img[i]<1) {
             dist[i] = edgedf(gx[i], gy[i], img[i]); // Gradient-assisted estimate
         }
         else {
-            dist[i]= 0.0; // Inside the object
+            dist[i]= 0; // Inside the object
         }
     }
     
@@ -570,3 +584,379 @@ void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, sho
     /* The transformation is completed. */
     
 }
+
+template <typename T>
+edt_edge_table<T>::edt_edge_table():df((LEVELS+1)*(ANGLES+1))
+{
+    for(int l=0; l<=LEVELS; l++) {
+        T a = T(l)/LEVELS;
+        for(int k=0; k<=ANGLES; k++) {
+            df[l*(ANGLES+1) + k] = edgedf(T(1), T(k)/ANGLES, a);
+        }
+    }
+}
+
+template <typename T>
+edt_edge_table<T> const & edt_get_edge_table()
+{
+    static const edt_edge_table<T> table;
+    return table;
+}
+
+/*
+ * State of one half of edtaa3_bipolar(). The inside half reads the image
+ * as 1-img; its gradient is the negated outside gradient, and edgedf()
+ * only looks at the gradient's magnitude, so both halves share gx, gy.
+ */
+template <typename T, typename O, bool Inverted>
+struct edt_half
+{
+    typedef T value_type;
+    
+    T *img, *gx, *gy;
+    int w;
+    O *distx, *disty;
+    T *dist;
+    long changed; // updates in the current pass
+    const edt_edge_table<T> *table; // quantized distaa3(), or NULL for the exact one
+    
+    inline T coverage(int i) const { return Inverted ? 1 - img[i] : img[i]; }
+    inline T distance(int i) const { return dist[i]; }
+    
+    void init(int n)
+    {
+        for(int i=0; i<n; i++) {
+            T a = coverage(i);
+            distx[i] = 0;
+            disty[i] = 0;
+            if(a <= 0) {
+                dist[i] = T(1000000.0); // Big value, means "not set yet"
+            } else if(a < 1) {
+                dist[i] = edgedf(gx[i], gy[i], a); // Gradient-assisted estimate
+            } else {
+                dist[i] = 0; // Inside the object
+            }
+        }
+    }
+    
+    // Tests the neighbor at index c, offset (ox,oy) from pixel i, as a
+    // source of a closer edge pixel for i. Same as one step of edtaa3().
+    inline void relax(int i, int c, int ox, int oy, T & olddist)
+    {
+        const T epsilon = T(1e-3);
+        int cdistx = distx[c];
+        int cdisty = disty[c];
+        int newdistx = cdistx+ox;
+        int newdisty = cdisty+oy;
+        int closest = c-cdistx-cdisty*w;
+        T newdist = table ? table->distaa3(coverage(closest), gx[closest], gy[closest], newdistx, newdisty)
+                          : distaa3_edge(coverage(closest), gx[closest], gy[closest], newdistx, newdisty);
+        if(newdist < olddist-epsilon)
+        {
+            distx[i]=newdistx;
+            disty[i]=newdisty;
+            dist[i]=newdist;
+            olddist=newdist;
+            changed++;
+        }
+    }
+};
+
+/*
+ * Pixel x of row y (index i) in the downward scan: propagate from the
+ * left, upper left, up and upper right neighbors.
+ */
+template <typename H>
+static inline void edt_down(H & h, int i, int x, int w)
+{
+    typename H::value_type olddist = h.distance(i);
+    if(olddist <= 0) return;
+    if(x > 0) {
+        h.relax(i, i-1, 1, 0, olddist);
+        h.relax(i, i-w-1, 1, 1, olddist);
+    }
+    h.relax(i, i-w, 0, 1, olddist);
+    if(x < w-1) h.relax(i, i-w+1, -1, 1, olddist);
+}
+
+/*
+ * Pixel x of row y (index i) in the upward scan: propagate from the
+ * right, lower right, down and lower left neighbors.
+ */
+template <typename H>
+static inline void edt_up(H & h, int i, int x, int w)
+{
+    typename H::value_type olddist = h.distance(i);
+    if(olddist <= 0) return;
+    if(x < w-1) {
+        h.relax(i, i+1, -1, 0, olddist);
+        h.relax(i, i+w+1, -1, -1, olddist);
+    }
+    h.relax(i, i+w, 0, -1, olddist);
+    if(x > 0) h.relax(i, i+w-1, 1, -1, olddist);
+}
+
+/*
+ * Single neighbor step of the reverse row scans: from the right (dir=1)
+ * or the left (dir=-1).
+ */
+template <typename H>
+static inline void edt_row(H & h, int i, int dir)
+{
+    typename H::value_type olddist = h.distance(i);
+    if(olddist <= 0) return;
+    h.relax(i, i+dir, -dir, 0, olddist);
+}
+
+/*
+ * Same state as edt_half, kept in two interleaved arrays: the edge data
+ * each candidate looks up (coverage and gradient) and the per-pixel
+ * propagation state (distance and offset). A candidate test then touches
+ * two cache lines instead of six streams.
+ */
+template <typename T, typename O, bool Inverted>
+struct edt_half_packed
+{
+    typedef T value_type;
+    
+    const edt_source<T> *src;
+    int w;
+    edt_cell<T, O> *cell;
+    long changed; // updates in the current pass
+    const edt_edge_table<T> *table; // quantized distaa3(), or NULL for the exact one
+    
+    inline T coverage(const edt_source<T> & e) const { return Inverted ? 1 - e.a : e.a; }
+    inline T distance(int i) const { return cell[i].dist; }
+    
+    void init(int n)
+    {
+        for(int i=0; i<n; i++) {
+            T a = coverage(src[i]);
+            edt_cell<T, O> & p = cell[i];
+            p.dx = 0;
+            p.dy = 0;
+            if(a <= 0) {
+                p.dist = T(1000000.0); // Big value, means "not set yet"
+            } else if(a < 1) {
+                p.dist = edgedf(src[i].gx, src[i].gy, a); // Gradient-assisted estimate
+            } else {
+                p.dist = 0; // Inside the object
+            }
+        }
+    }
+    
+    inline void relax(int i, int c, int ox, int oy, T & olddist)
+    {
+        const T epsilon = T(1e-3);
+        const edt_cell<T, O> & cc = cell[c];
+        int newdistx = cc.dx+ox;
+        int newdisty = cc.dy+oy;
+        const edt_source<T> & e = src[c-cc.dx-cc.dy*w];
+        T newdist = table ? table->distaa3(coverage(e), e.gx, e.gy, newdistx, newdisty)
+                          : distaa3_edge(coverage(e), e.gx, e.gy, newdistx, newdisty);
+        if(newdist < olddist-epsilon)
+        {
+            edt_cell<T, O> & p = cell[i];
+            p.dx=newdistx;
+            p.dy=newdisty;
+            p.dist=newdist;
+            olddist=newdist;
+            changed++;
+        }
+    }
+};
+
+/*
+ * The same sweeps as edtaa3(), visiting every pixel once for both
+ * halves. A half that went through a whole pass unchanged is done;
+ * further passes would not change it either, so it is skipped.
+ *
+ * A row scan only reads the row itself and the row it propagates from.
+ * With limits.dirty_rows set, a scan whose two rows have not changed
+ * since the row was last scanned in the same direction is skipped: it
+ * would find nothing new.
+ */
+template <typename H_out, typename H_in>
+static void edt_bipolar_sweeps(H_out & out, H_in & in, int w, int h,
+                               edt_limits const & limits, edt_stats * stats)
+{
+    int x, y, i;
+    
+    out.init(w*h);
+    in.init(w*h);
+    
+    // Dirty-row bookkeeping, in ticks of a counter bumped for every row
+    // scan: when each row last changed, and when it was last scanned
+    // downward and upward.
+    const bool dirty = limits.dirty_rows;
+    std::vector<long> changed_at(dirty ? h : 0, 1), down_at(dirty ? h : 0, 0), up_at(dirty ? h : 0, 0);
+    long tick = 1;
+    
+    int passes = 0;
+    long rows_skipped = 0;
+    if(stats) stats->changed.clear();
+    
+    while(out.changed || in.changed)
+    {
+        if(limits.max_passes > 0 && passes >= limits.max_passes) break;
+        
+        const bool do_out = out.changed != 0, do_in = in.changed != 0;
+        out.changed = 0;
+        in.changed = 0;
+        
+        /* Scan rows, except first row */
+        for(y=1; y<h; y++)
+        {
+            if(dirty && std::max(changed_at[y-1], changed_at[y]) <= down_at[y]) {
+                rows_skipped++;
+                continue;
+            }
+            long before = out.changed + in.changed;
+            for(x=0, i=y*w; x<w; x++, i++) {
+                if(do_out) edt_down(out, i, x, w);
+                if(do_in) edt_down(in, i, x, w);
+            }
+            for(x=w-2, i=y*w+w-2; x>=0; x--, i--) {
+                if(do_out) edt_row(out, i, 1);
+                if(do_in) edt_row(in, i, 1);
+            }
+            if(dirty) {
+                down_at[y] = ++tick;
+                if(out.changed + in.changed != before) changed_at[y] = tick;
+            }
+        }
+        
+        /* Scan rows in reverse order, except last row */
+        for(y=h-2; y>=0; y--)
+        {
+            if(dirty && std::max(changed_at[y], changed_at[y+1]) <= up_at[y]) {
+                rows_skipped++;
+                continue;
+            }
+            long before = out.changed + in.changed;
+            for(x=w-1, i=y*w+w-1; x>=0; x--, i--) {
+                if(do_out) edt_up(out, i, x, w);
+                if(do_in) edt_up(in, i, x, w);
+            }
+            for(x=1, i=y*w+1; x<w; x++, i++) {
+                if(do_out) edt_row(out, i, -1);
+                if(do_in) edt_row(in, i, -1);
+            }
+            if(dirty) {
+                up_at[y] = ++tick;
+                if(out.changed + in.changed != before) changed_at[y] = tick;
+            }
+        }
+        
+        passes++;
+        if(stats) stats->changed.push_back(out.changed + in.changed);
+    }
+    
+    if(stats) {
+        stats->passes = passes;
+        stats->converged = (out.changed == 0 && in.changed == 0);
+        stats->rows_skipped = rows_skipped;
+    }
+}
+
+template <typename T, typename O>
+void edtaa3_bipolar(T *img, T *gx, T *gy, int w, int h,
+                    O *distx, O *disty, T *dist,
+                    O *distx_in, O *disty_in, T *dist_in,
+                    edt_limits const & limits, edt_stats * stats,
+                    const edt_edge_table<T> * table)
+{
+    edt_half<T, O, false> out = { img, gx, gy, w, distx, disty, dist, 1, table };
+    edt_half<T, O, true> in = { img, gx, gy, w, distx_in, disty_in, dist_in, 1, table };
+    
+    edt_bipolar_sweeps(out, in, w, h, limits, stats);
+    
+    /* distmap = outside - inside; % Bipolar distance field */
+    for(int i=0; i<w*h; i++) {
+        T o = dist[i] < 0 ? 0 : dist[i];
+        T n = dist_in[i] < 0 ? 0 : dist_in[i];
+        dist[i] = o - n;
+    }
+}
+
+template <typename T, typename O>
+void edtaa3_bipolar_packed(T *img, T *gx, T *gy, int w, int h,
+                           edt_source<T> *src, edt_cell<T, O> *cell, edt_cell<T, O> *cell_in, T *dist,
+                           edt_limits const & limits, edt_stats * stats,
+                           const edt_edge_table<T> * table)
+{
+    for(int i=0; i<w*h; i++) {
+        src[i].a = img[i];
+        src[i].gx = gx[i];
+        src[i].gy = gy[i];
+    }
+    
+    edt_half_packed<T, O, false> out = { src, w, cell, 1, table };
+    edt_half_packed<T, O, true> in = { src, w, cell_in, 1, table };
+    
+    edt_bipolar_sweeps(out, in, w, h, limits, stats);
+    
+    /* distmap = outside - inside; % Bipolar distance field */
+    for(int i=0; i<w*h; i++) {
+        T o = cell[i].dist < 0 ? 0 : cell[i].dist;
+        T n = cell_in[i].dist < 0 ? 0 : cell_in[i].dist;
+        dist[i] = o - n;
+    }
+}
+
+// Explicit instantiations. float is what the glyph pipeline uses; double is
+// kept as a reference to compare the single-precision results against.
+template void computegradient<float>(float *img, int w, int h, float *gx, float *gy);
+template void computegradient<double>(double *img, int w, int h, double *gx, double *gy);
+template float edgedf<float>(float gx, float gy, float a);
+template double edgedf<double>(double gx, double gy, double a);
+template float distaa3<float>(float *img, float *gximg, float *gyimg, int w, int c, int xc, int yc, int xi, int yi);
+template double distaa3<double>(double *img, double *gximg, double *gyimg, int w, int c, int xc, int yc, int xi, int yi);
+template void edtaa3<float, short>(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist);
+template void edtaa3<float, int>(float *img, float *gx, float *gy, int w, int h, int *distx, int *disty, float *dist);
+template void edtaa3<double, short>(double *img, double *gx, double *gy, int w, int h, short *distx, short *disty, double *dist);
+template void edtaa3<double, int>(double *img, double *gx, double *gy, int w, int h, int *distx, int *disty, double *dist);
+template struct edt_edge_table<float>;
+template struct edt_edge_table<double>;
+template edt_edge_table<float> const & edt_get_edge_table<float>();
+template edt_edge_table<double> const & edt_get_edge_table<double>();
+template void edtaa3_bipolar<float, short>(float *img, float *gx, float *gy, int w, int h,
+                                           short *distx, short *disty, float *dist,
+                                           short *distx_in, short *disty_in, float *dist_in,
+                                           edt_limits const & limits, edt_stats * stats,
+                                           const edt_edge_table<float> * table);
+template void edtaa3_bipolar<float, int>(float *img, float *gx, float *gy, int w, int h,
+                                         int *distx, int *disty, float *dist,
+                                         int *distx_in, int *disty_in, float *dist_in,
+                                         edt_limits const & limits, edt_stats * stats,
+                                         const edt_edge_table<float> * table);
+template void edtaa3_bipolar<double, short>(double *img, double *gx, double *gy, int w, int h,
+                                            short *distx, short *disty, double *dist,
+                                            short *distx_in, short *disty_in, double *dist_in,
+                                            edt_limits const & limits, edt_stats * stats,
+                                            const edt_edge_table<double> * table);
+template void edtaa3_bipolar<double, int>(double *img, double *gx, double *gy, int w, int h,
+                                          int *distx, int *disty, double *dist,
+                                          int *distx_in, int *disty_in, double *dist_in,
+                                          edt_limits const & limits, edt_stats * stats,
+                                          const edt_edge_table<double> * table);
+template void edtaa3_bipolar_packed<float, short>(float *img, float *gx, float *gy, int w, int h,
+                                                  edt_source<float> *src, edt_cell<float, short> *cell,
+                                                  edt_cell<float, short> *cell_in, float *dist,
+                                                  edt_limits const & limits, edt_stats * stats,
+                                                  const edt_edge_table<float> * table);
+template void edtaa3_bipolar_packed<float, int>(float *img, float *gx, float *gy, int w, int h,
+                                                edt_source<float> *src, edt_cell<float, int> *cell,
+                                                edt_cell<float, int> *cell_in, float *dist,
+                                                edt_limits const & limits, edt_stats * stats,
+                                                const edt_edge_table<float> * table);
+template void edtaa3_bipolar_packed<double, short>(double *img, double *gx, double *gy, int w, int h,
+                                                   edt_source<double> *src, edt_cell<double, short> *cell,
+                                                   edt_cell<double, short> *cell_in, double *dist,
+                                                   edt_limits const & limits, edt_stats * stats,
+                                                   const edt_edge_table<double> * table);
+template void edtaa3_bipolar_packed<double, int>(double *img, double *gx, double *gy, int w, int h,
+                                                 edt_source<double> *src, edt_cell<double, int> *cell,
+                                                 edt_cell<double, int> *cell_in, double *dist,
+                                                 edt_limits const & limits, edt_stats * stats,
+                                                 const edt_edge_table<double> * table);
@@ -60,8 +60,130 @@
 #ifndef makeglfont_edtaa3func_h
 #define makeglfont_edtaa3func_h
 
-void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, short *disty, double *dist);
-void computegradient(double *img, int w, int h, double *gx, double *gy);
+#include <cmath>
+#include <vector>
+
+// T is the pixel/distance scalar type. Instantiated for float (used by the
+// glyph pipeline) and double (reference precision). O is the type of the
+// stored offsets to the closest edge pixel: short is enough for images up
+// to 32767 pixels on a side and halves the offset traffic, int covers
+// anything larger.
+template <typename T, typename O>
+void edtaa3(T *img, T *gx, T *gy, int w, int h, O *distx, O *disty, T *dist);
+template <typename T>
+void computegradient(T *img, int w, int h, T *gx, T *gy);
+
+// Distance from the center of an edge pixel with coverage a to the edge,
+// estimated from the edge direction (gx,gy).
+template <typename T>
+T edgedf(T gx, T gy, T a);
+
+// Anti-aliased distance from pixel c to the edge pixel at offset (xc,yc)
+// from c, for a pixel at offset (xi,yi) from that edge pixel.
+template <typename T>
+T distaa3(T *img, T *gximg, T *gyimg, int w, int c, int xc, int yc, int xi, int yi);
+
+// Limits on the sweep loop of edtaa3_bipolar(). By default it sweeps until
+// nothing changes. max_passes > 0 stops it after that many passes, even if
+// it has not converged. dirty_rows skips row scans that cannot change
+// anything because the rows they read are unchanged since the last scan.
+struct edt_limits
+{
+    int max_passes;
+    bool dirty_rows;
+    
+    edt_limits():max_passes(0), dirty_rows(false) {}
+};
+
+// What the sweep loop did: number of passes, pixel updates in each pass
+// (both halves), whether the last pass changed nothing, and how many row
+// scans the dirty-row mode skipped. When the edge table is checked
+// against the exact computation (make_distance_map()), also the largest
+// and mean difference of the two bipolar fields, in pixels.
+struct edt_stats
+{
+    int passes;
+    bool converged;
+    long rows_skipped;
+    std::vector<long> changed;
+    
+    bool table_checked;
+    double table_error_max, table_error_mean;
+    
+    edt_stats():passes(0), converged(true), rows_skipped(0),
+                table_checked(false), table_error_max(0), table_error_mean(0) {}
+};
+
+// distaa3() with the edge term edgedf(xi,yi,a) read from a table instead
+// of computed: edgedf() of a unit edge direction only depends on the
+// direction's octant-folded slope and on the coverage, so the table is
+// indexed by the slope (interpolated) and the coverage (in 1/LEVELS steps,
+// which is exact for 8-bit renders). The gradient-based estimate at the
+// edge pixel itself (xi=yi=0) is still computed.
+template <typename T>
+struct edt_edge_table
+{
+    enum { ANGLES = 128, LEVELS = 255 };
+    std::vector<T> df; // (LEVELS+1) rows of ANGLES+1 slopes
+    
+    edt_edge_table();
+    
+    inline T distaa3(T a, T gx, T gy, int xi, int yi) const
+    {
+        if(a > 1) a = 1;
+        if(a < 0) a = 0;
+        if(a == 0) return T(1000000.0);
+        int ax = xi < 0 ? -xi : xi;
+        int ay = yi < 0 ? -yi : yi;
+        if(ax < ay) { int t = ax; ax = ay; ay = t; }
+        if(ax == 0) return edgedf(gx, gy, a);
+        T s = T(ay)*ANGLES/ax;
+        int k = (int)s;
+        if(k >= ANGLES) k = ANGLES-1;
+        const T *row = &df[(int)(a*LEVELS + T(0.5))*(ANGLES+1)];
+        T di = std::sqrt(T(ax)*ax + T(ay)*ay);
+        return di + row[k] + (s-k)*(row[k+1]-row[k]);
+    }
+};
+
+// The shared table, built on first use.
+template <typename T>
+edt_edge_table<T> const & edt_get_edge_table();
+
+// Both halves of the bipolar distance field in one set of sweeps: the
+// distance outside the object (as edtaa3(img)) and inside it (as
+// edtaa3(1-img)), from the gradient of img. On return dist holds
+// outside - inside, each clamped to positive values first; the *_in
+// buffers are scratch.
+template <typename T, typename O>
+void edtaa3_bipolar(T *img, T *gx, T *gy, int w, int h,
+                    O *distx, O *disty, T *dist,
+                    O *distx_in, O *disty_in, T *dist_in,
+                    edt_limits const & limits = edt_limits(), edt_stats * stats = 0,
+                    const edt_edge_table<T> * table = 0);
+
+// Per-pixel records for edtaa3_bipolar_packed(): what a candidate reads
+// from its edge pixel, and the propagation state of a pixel.
+template <typename T>
+struct edt_source
+{
+    T a, gx, gy;
+};
+
+template <typename T, typename O>
+struct edt_cell
+{
+    T dist;
+    O dx, dy;
+};
+
+// edtaa3_bipolar() with interleaved per-pixel state. src, cell and cell_in
+// are w*h scratch arrays; dist receives the bipolar field.
+template <typename T, typename O>
+void edtaa3_bipolar_packed(T *img, T *gx, T *gy, int w, int h,
+                           edt_source<T> *src, edt_cell<T, O> *cell, edt_cell<T, O> *cell_in, T *dist,
+                           edt_limits const & limits = edt_limits(), edt_stats * stats = 0,
+                           const edt_edge_table<T> * table = 0);
 
 
 #endif
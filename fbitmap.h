@@ -36,6 +36,12 @@
 
 #include <vector>
 
+// Pixel of a 3-channel (RGB) bitmap, as written by stbi_write_png with comp=3.
+struct rgb_pixel
+{
+    unsigned char r, g, b;
+};
+
 template <typename T>
 struct fbitmap
 {
@@ -0,0 +1,104 @@
+//
+//  font_data.cpp
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "font_data.h"
+
+std::shared_ptr<font_data> font_data::open(const std::string & path)
+{
+    std::shared_ptr<font_data> fd(new font_data());
+
+#if defined(_WIN32)
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!in) {
+        fprintf(stderr, "Can't open font file %s\n", path.c_str());
+        return std::shared_ptr<font_data>();
+    }
+    fd->length = (size_t)in.tellg();
+    fd->bytes = new unsigned char[fd->length];
+    in.seekg(0);
+    in.read((char*)fd->bytes, fd->length);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if(file < 0) {
+        fprintf(stderr, "Can't open font file %s: %s\n", path.c_str(), strerror(errno));
+        return std::shared_ptr<font_data>();
+    }
+    struct stat st;
+    if(fstat(file, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Can't read font file %s\n", path.c_str());
+        close(file);
+        return std::shared_ptr<font_data>();
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping stays valid after the descriptor is closed.
+    close(file);
+    if(p == MAP_FAILED) {
+        fprintf(stderr, "Can't map font file %s: %s\n", path.c_str(), strerror(errno));
+        return std::shared_ptr<font_data>();
+    }
+    fd->bytes = (unsigned char*)p;
+    fd->length = (size_t)st.st_size;
+    fd->mapped = true;
+#endif
+
+    return fd;
+}
+
+font_data::~font_data()
+{
+#if !defined(_WIN32)
+    if(mapped) {
+        munmap(bytes, length);
+        return;
+    }
+#endif
+    delete [] bytes;
+}
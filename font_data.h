@@ -0,0 +1,76 @@
+//
+//  font_data.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__font_data__
+#define __makeglfont__font_data__
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/**
+ * font_data
+ * The bytes of a font file, mapped into memory once (read into memory
+ * where mmap isn't available) and unmapped when the last owner lets go.
+ * Faces are created over it with FT_New_Memory_Face(), which does not
+ * copy the data, so every face using it must hold a reference: FreeType
+ * reads glyphs from the mapping for the face's whole lifetime.
+ */
+class font_data
+{
+public:
+    // Returns an empty pointer, after printing why, if the file can't be
+    // opened or mapped.
+    static std::shared_ptr<font_data> open(const std::string & path);
+
+    ~font_data();
+
+    const unsigned char * data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    font_data():bytes(NULL), length(0), mapped(false) {}
+    font_data(const font_data &);
+    font_data & operator = (const font_data &);
+
+    unsigned char *bytes;
+    size_t length;
+    bool mapped; // false: bytes came from new[]
+};
+
+#endif /* defined(__makeglfont__font_data__) */
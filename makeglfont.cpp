@@ -39,10 +39,14 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 // FreeType
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_OUTLINE_H
 #undef __FTERRORS_H__
 #define FT_ERRORDEF( e, v, s )  { e, s },
 #define FT_ERROR_START_LIST     {
@@ -70,7 +74,12 @@ const struct {
 // Freetype GL functions
 #include "distance_map.h"
 
+#include "outline_sdf.h"
+
 #include "fbitmap.h"
+#include "font_data.h"
+#include "span_raster.h"
+#include "parallel.h"
 
 
 // Define VERBOSENESS to get too much output.
@@ -91,10 +100,12 @@ inline void utf_append(uint32_t cp, std::string & result) {
 
 class ftwrapper {
 public:
+    std::shared_ptr<font_data> data; // kept alive for as long as the face
     FT_Library library;
     FT_Face face;
     FT_Error error;
     bool valid;
+    float pixel_size; // last size passed to set_pixel_size(), 0 before
     
     inline void check_fterr() {
         if( error )
@@ -105,12 +116,12 @@ public:
         }
     }
     
-    ftwrapper(std::string fontfile):valid(true) {
+    ftwrapper(std::shared_ptr<font_data> fontdata):data(fontdata), valid(true), pixel_size(0), scaled(), scaled_advance(0) {
         this->error = FT_Init_FreeType( &this->library );
         check_fterr();
         if( error ) { exit(1); }
 
-        this->error = FT_New_Face( this->library, fontfile.c_str(), 0, &this->face );
+        this->error = FT_New_Memory_Face( this->library, data->data(), (FT_Long)data->size(), 0, &this->face );
         check_fterr();
         if( error ) { exit(1); }
 
@@ -120,14 +131,21 @@ public:
     }
     
     ~ftwrapper() {
+        for(std::map<FT_UInt, cached_outline>::iterator it = outlines.begin(); it != outlines.end(); ++it) {
+            FT_Outline_Done( library, &it->second.outline );
+        }
+        FT_Outline_Done( library, &scaled );
         FT_Done_Face( face );
         FT_Done_FreeType( library );
     }
     
-    inline bool set_pixel_size(int pixel_size) {
+    // pixel_size may be fractional; FreeType rounds it to 26.6 (1/64 pixel).
+    // At 72 dpi a point is a pixel, so whole sizes match FT_Set_Pixel_Sizes().
+    inline bool set_pixel_size(float pixel_size) {
         if(valid) {
-            error = FT_Set_Pixel_Sizes(face, 0, pixel_size);
+            error = FT_Set_Char_Size(face, 0, (FT_F26Dot6)std::round(pixel_size*64), 72, 72);
             check_fterr();
+            this->pixel_size = pixel_size;
         }
         return (valid && !error);
     }
@@ -148,6 +166,118 @@ public:
         return (valid && !error);
     }
     
+    // Scales a glyph's outline to the current size into outline(), with its
+    // advance in outline_advance(). Each glyph is read from the font only
+    // once, unscaled (FT_LOAD_NO_SCALE), and cached; every size after that
+    // is a copy and an FT_Outline_Transform(). Returns false if the glyph
+    // has no outline (bitmap fonts), which leaves load_glyph() for it.
+    inline bool load_outline(FT_UInt glyph_index) {
+        if(!valid) {
+            return false;
+        }
+        std::map<FT_UInt, cached_outline>::iterator it = outlines.find(glyph_index);
+        if(it == outlines.end()) {
+            cached_outline c = cached_outline();
+            error = FT_Load_Glyph( face, glyph_index, FT_LOAD_NO_SCALE );
+            check_fterr();
+            if(!error && face->glyph->format == FT_GLYPH_FORMAT_OUTLINE) {
+                FT_Outline const & src = face->glyph->outline;
+                error = FT_Outline_New( library, src.n_points, src.n_contours, &c.outline );
+                check_fterr();
+                if(!error) {
+                    FT_Outline_Copy( &src, &c.outline );
+                    c.advance = face->glyph->advance.x;
+                    c.valid = true;
+                }
+            }
+            it = outlines.insert(std::make_pair(glyph_index, c)).first;
+        }
+        cached_outline const & c = it->second;
+        if(!c.valid) {
+            return false;
+        }
+        if(scaled.n_points != c.outline.n_points || scaled.n_contours != c.outline.n_contours) {
+            FT_Outline_Done( library, &scaled );
+            error = FT_Outline_New( library, c.outline.n_points, c.outline.n_contours, &scaled );
+            check_fterr();
+            if(error) {
+                return false;
+            }
+        }
+        FT_Outline_Copy( &c.outline, &scaled );
+        FT_Matrix m = { face->size->metrics.x_scale, 0, 0, face->size->metrics.y_scale };
+        FT_Outline_Transform( &scaled, &m );
+        scaled_advance = FT_MulFix( c.advance, face->size->metrics.x_scale );
+        return true;
+    }
+    
+    inline FT_Outline * outline() {
+        return &scaled;
+    }
+    
+    inline FT_Pos outline_advance() {
+        return scaled_advance;
+    }
+    
+    // Renders the outline() as runs into spans, instead of
+    // into the glyph slot's bitmap. The glyph box (left, top, width, rows)
+    // is the bitmap render_glyph() would produce; spans gets x_pad and
+    // y_pad pixels of empty padding around it.
+    inline bool render_spans(span_raster & spans, int left, int top, int width, int rows,
+                             int x_pad, int y_pad) {
+        spans.reset(width + x_pad*2, rows + y_pad*2);
+        if(valid) {
+            span_target target = { &spans, left - x_pad, top + y_pad };
+            FT_Raster_Params params;
+            memset(&params, 0, sizeof(params));
+            params.flags = FT_RASTER_FLAG_AA | FT_RASTER_FLAG_DIRECT | FT_RASTER_FLAG_CLIP;
+            params.gray_spans = add_spans;
+            params.user = &target;
+            params.clip_box.xMin = left;
+            params.clip_box.yMin = top - rows;
+            params.clip_box.xMax = left + width;
+            params.clip_box.yMax = top;
+            error = FT_Outline_Render( library, &scaled, &params );
+            check_fterr();
+        }
+        spans.finish();
+        return (valid && !error);
+    }
+    
+    // Renders the outline() into dst, rows of stride floats
+    // stored top row first, as coverage normalized to [0,1]. The glyph box
+    // (left, top, width, rows) is the bitmap render_glyph() would produce;
+    // it lands x_pad columns and y_pad rows into dst. Only covered pixels
+    // are written, so dst has to be cleared first. With band_rows set, only
+    // that many rows of the padded image are rendered, starting at row
+    // band_y, into the first rows of dst.
+    inline bool render_coverage(float *dst, size_t stride, int left, int top, int width, int rows,
+                                int x_pad, int y_pad, int band_y = 0, int band_rows = 0) {
+        if(valid) {
+            const int band_top = top + y_pad - band_y; // glyph y just above the band
+            coverage_target target = { dst, stride, left - x_pad, band_top };
+            FT_Raster_Params params;
+            memset(&params, 0, sizeof(params));
+            params.flags = FT_RASTER_FLAG_AA | FT_RASTER_FLAG_DIRECT | FT_RASTER_FLAG_CLIP;
+            params.gray_spans = add_coverage;
+            params.user = &target;
+            params.clip_box.xMin = left;
+            params.clip_box.yMin = top - rows;
+            params.clip_box.xMax = left + width;
+            params.clip_box.yMax = top;
+            if(band_rows > 0) {
+                params.clip_box.yMin = std::max(top - rows, band_top - band_rows);
+                params.clip_box.yMax = std::min(top, band_top);
+                if(params.clip_box.yMin >= params.clip_box.yMax) {
+                    return true;
+                }
+            }
+            error = FT_Outline_Render( library, &scaled, &params );
+            check_fterr();
+        }
+        return (valid && !error);
+    }
+    
     inline FT_UInt get_char_index(FT_ULong charcode ) {
         if(valid)
             return FT_Get_Char_Index( face, charcode );
@@ -168,10 +298,145 @@ public:
     }
 
 private:
+    // A glyph as load_outline() reads it from the font, in font units.
+    struct cached_outline
+    {
+        bool valid; // false if the glyph has no outline
+        FT_Outline outline;
+        FT_Pos advance;
+    };
+    
+    std::map<FT_UInt, cached_outline> outlines;
+    FT_Outline scaled; // the last glyph load_outline() scaled
+    FT_Pos scaled_advance;
+    
+    // Where render_spans() puts FreeType's spans: (left, top) are the glyph
+    // coordinates of the raster's top left pixel.
+    struct span_target
+    {
+        span_raster *spans;
+        int left, top;
+    };
+    
+    static void add_spans(int y, int count, const FT_Span *spans, void *user) {
+        span_target *target = (span_target *)user;
+        for(int k = 0; k < count; ++k) {
+            target->spans->add(spans[k].x - target->left, target->top - 1 - y,
+                               spans[k].len, spans[k].coverage);
+        }
+    }
+    
+    // Where render_coverage() puts FreeType's spans, like span_target.
+    struct coverage_target
+    {
+        float *data;
+        size_t stride;
+        int left, top;
+    };
+    
+    static void add_coverage(int y, int count, const FT_Span *spans, void *user) {
+        coverage_target *target = (coverage_target *)user;
+        float *row = target->data + (target->top - 1 - y)*target->stride;
+        for(int k = 0; k < count; ++k) {
+            float v = spans[k].coverage/255.0f;
+            float *d = row + (spans[k].x - target->left);
+            std::fill(d, d + spans[k].len, v);
+        }
+    }
+    
     ftwrapper&  operator = (const ftwrapper& ftw);
     ftwrapper(const ftwrapper& ftw);
 };
 
+// FreeType faces, and the FT_Library they come from, must not be used from
+// two threads at once. A face_pool keeps one ftwrapper per worker, all
+// over the same font_data. checkout() hands out a free one, set to the
+// pool's pixel size, waiting while they are all in use; the lease returns
+// it when it goes out of scope. Faces are opened as they are first needed,
+// up to "capacity", and keep their outline caches between checkouts.
+
+class face_pool {
+public:
+    class lease {
+    public:
+        lease(lease && other):pool(other.pool), ftw(other.ftw) { other.ftw = NULL; }
+        ~lease() { if(ftw) { pool->give_back(ftw); } }
+        ftwrapper & operator * () const { return *ftw; }
+        ftwrapper * operator -> () const { return ftw; }
+    private:
+        friend class face_pool;
+        lease(face_pool *p, ftwrapper *f):pool(p), ftw(f) {}
+        lease(const lease &);
+        lease & operator = (const lease &);
+        face_pool *pool;
+        ftwrapper *ftw;
+    };
+    
+    face_pool(std::shared_ptr<font_data> fontdata, int capacity)
+    :data(fontdata), capacity(std::max(1, capacity)), pixel_size(0) {}
+    
+    ~face_pool() {
+        for(size_t i = 0; i < faces.size(); ++i) {
+            delete faces[i];
+        }
+    }
+    
+    // Applies to every face from the next checkout on.
+    void set_pixel_size(float size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pixel_size = size;
+    }
+    
+    lease checkout() {
+        ftwrapper *ftw = NULL;
+        float size;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(idle.empty() && (int)faces.size() >= capacity) {
+                returned.wait(lock);
+            }
+            if(!idle.empty()) {
+                ftw = idle.back();
+                idle.pop_back();
+            }
+            size = pixel_size;
+            if(!ftw) {
+                // Opened outside the lock; counts against capacity now.
+                faces.push_back(NULL);
+            }
+        }
+        if(!ftw) {
+            ftw = new ftwrapper(data);
+            std::lock_guard<std::mutex> lock(mutex);
+            *std::find(faces.begin(), faces.end(), (ftwrapper*)NULL) = ftw;
+        }
+        if(size > 0 && ftw->pixel_size != size) {
+            ftw->set_pixel_size(size);
+        }
+        return lease(this, ftw);
+    }
+    
+private:
+    void give_back(ftwrapper *ftw) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.push_back(ftw);
+        }
+        returned.notify_one();
+    }
+    
+    std::shared_ptr<font_data> data;
+    int capacity;
+    float pixel_size;
+    std::vector<ftwrapper*> faces; // every face opened, idle or leased
+    std::vector<ftwrapper*> idle;
+    std::mutex mutex;
+    std::condition_variable returned;
+    
+    face_pool & operator = (const face_pool &);
+    face_pool(const face_pool &);
+};
+
 
 
 
@@ -186,9 +451,16 @@ struct glyph
     float bearing_y; // offset from baseline to top of glyph's bbox
     float advance_x; // horizontal distance to increment pen position when glyph is drawn
     fbitmap<unsigned char> bmp;
+    fbitmap<rgb_pixel> msdf; // multi-channel field, only in MSDF mode
     std::map<uint32_t, float> kernings; // map of kern pairs relative to this glyph;
     // <previous character in character pair, kern value in pixels>
     float s0, t0, s1, t1; // final texture coordinates after packing.
+    int atlas_x, atlas_y; // packed position of the bmp's bottom-left corner, in pixels
+    int sdf_scale; // supersampling factor the distance field was computed with
+    // Texel centers of the distance field, in pixels from the pen position:
+    // texel (i, j), counted from the top left, is centered at
+    // (texel_x0 + i*texel_dx, texel_y0 - j*texel_dy).
+    float texel_x0, texel_y0, texel_dx, texel_dy;
     
     inline void scale (float factor) {
         advance_x *= factor;
@@ -200,18 +472,145 @@ struct glyph
     
 };
 
+/**
+ * Scratch memory for load_glyph(): the padded high-res input, the resized
+ * low-res field and the distance map's work buffers. Everything only grows,
+ * so reusing one workspace for a run of glyphs avoids allocating (and
+ * page-faulting) the hi-res buffers again for every glyph. Use one
+ * workspace per thread.
+ */
+struct glyph_workspace
+{
+    fbitmap<float> hi_res;
+    span_raster spans;
+    fbitmap<float> lo_res;
+    std::vector<float> rgb;
+    dm_workspace<float> dm;
+};
+
+/**
+ * How much each glyph is supersampled for the distance field (sdf_scale).
+ * Either one fixed factor for all glyphs, or, with hires_px set, the factor
+ * that renders the glyph's longer side at about hires_px pixels, clamped to
+ * [min_scale, max_scale]: large glyphs get smaller factors, thin and small
+ * ones larger. calibrate_hires_px() finds hires_px for an error budget.
+ */
+struct scale_policy
+{
+    int fixed_scale;
+    int hires_px;
+    int min_scale, max_scale;
+    
+    scale_policy(int scale = 16):fixed_scale(scale), hires_px(0), min_scale(2), max_scale(32) {}
+    
+    // extent: the glyph's longer side at the font size, in pixels.
+    int scale_for(float extent) const {
+        if(hires_px <= 0) {
+            return fixed_scale;
+        }
+        int scale = (int)std::ceil(hires_px/std::max(extent, 1.0f));
+        return std::min(std::max(scale, min_scale), max_scale);
+    }
+};
+
+/**
+ * The longer side of a glyph's box at font_size, in pixels.
+ */
+float glyph_extent(ftwrapper & ftw, FT_UInt glyph_index, float font_size) {
+    ftw.set_pixel_size(font_size);
+    FT_Pos width, height;
+    if(ftw.load_outline(glyph_index)) {
+        FT_BBox cbox;
+        FT_Outline_Get_CBox(ftw.outline(), &cbox);
+        width = cbox.xMax - cbox.xMin;
+        height = cbox.yMax - cbox.yMin;
+    } else {
+        ftw.load_glyph(glyph_index);
+        width = ftw.glyph()->metrics.width;
+        height = ftw.glyph()->metrics.height;
+    }
+    return std::max(width, height)/64.0f;
+}
+
+/**
+ * The padded hi-res glyph as a dm_band_source, for banded mode: the
+ * outline() rendered band by band, or rows of the glyph slot's bitmap.
+ */
+struct glyph_band
+{
+    ftwrapper *ftw;
+    bool outline;
+    int left, top, width, rows; // glyph box, as in ftwrapper::render_coverage()
+    int x_pad, y_pad;
+    
+    static void render(size_t y0, size_t y1, float *dst, void *user) {
+        glyph_band & b = *(glyph_band *)user;
+        const size_t stride = b.width + b.x_pad*2;
+        if(b.outline) {
+            b.ftw->render_coverage(dst, stride, b.left, b.top, b.width, b.rows, b.x_pad, b.y_pad,
+                                   (int)y0, (int)(y1 - y0));
+            return;
+        }
+        int ptch = b.ftw->glyph()->bitmap.pitch;
+        const unsigned char *buf = b.ftw->glyph()->bitmap.buffer;
+        for( size_t y=y0; y < y1; ++y )
+        {
+            const int j = (int)y - b.y_pad;
+            if(j < 0 || j >= b.rows) {
+                continue;
+            }
+            float *row = dst + (y - y0)*stride + b.x_pad;
+            for( int i=0; i < b.width; ++i )
+            {
+                row[i] = buf[j*ptch+i]/255.0f;
+            }
+        }
+    }
+};
+
+/**
+ * What load_glyph() produces besides the glyph metrics.
+ */
+enum glyph_output
+{
+    GLYPH_BITMAP,  // the distance field, in glyph::bmp
+    GLYPH_MEASURE, // only the size of glyph::bmp (its data stays empty)
+    GLYPH_ATLAS    // the distance field, straight into a rectangle of the atlas
+};
+
+struct glyph_target
+{
+    glyph_output output = GLYPH_BITMAP;
+    // GLYPH_ATLAS: the atlas and the glyph's packed rectangle in it, with
+    // (x, y) its bottom-left corner, as in fbmp::replace_part().
+    fbitmap<unsigned char> *atlas = NULL;
+    int x = 0, y = 0, width = 0, height = 0;
+};
+
 /** 
  * loads a glyph from FreeType.
  * @param face a FreeType2 font face
  * @param charcode a character code
- * @param font_size font size in pixels
+ * @param font_size font size in pixels, a multiple of 1/64
  * @param sdf_scale scale to use for the Signed Distance Field calculation
+ * @param dm_opts distance map settings (engine, threads)
+ * @param workspace scratch buffers, reused between calls
+ * @param stats if not NULL, receives the edtaa3 engine's pass counts
+ * @param target where the distance field goes (see glyph_output). Measuring
+ * does not render outline glyphs; writing into the atlas skips the low-res
+ * float and byte bitmaps and the copy into the atlas.
+ * With the analytic engine the distance field is computed from the glyph
+ * outline at the low-res texels instead (see outline_sdf.h). With
+ * dm_opts.spans the high-res glyph is rendered as runs rather than as a
+ * bitmap (see span_raster.h).
  * This function scales the face size to the font_size*sdf_scale, loads
  * the glyph bitmap, and creates a signed distance field based on the 
  * large bitmap. It returns a glyph filled with the scaled-down glyph
  * metrics and the scaled-down (resampled) signed distance field.
  */
-glyph load_glyph(ftwrapper & ftw, FT_ULong charcode, int font_size, int sdf_scale) {
+glyph load_glyph(ftwrapper & ftw, FT_ULong charcode, float font_size, int sdf_scale,
+                 dm_options const & dm_opts, glyph_workspace & workspace,
+                 edt_stats * stats = NULL, glyph_target const & target = glyph_target()) {
         
     // retrieve glyph index from character code
     FT_UInt glyph_index = ftw.get_char_index( charcode );
@@ -223,32 +622,63 @@ glyph load_glyph(ftwrapper & ftw, FT_ULong charcode, int font_size, int sdf_scal
         exit(0);
     }
     
-    // load glyph image into the slot, erasing previous image
+    // Scale the glyph's cached outline to the size. Outlines are measured
+    // from their control box and rendered straight into the padded working
+    // buffer below; glyphs without one (bitmap fonts) are loaded into the
+    // slot and go through its bitmap.
     
     ftw.set_pixel_size(font_size*sdf_scale);
-    ftw.load_glyph(glyph_index);
-    ftw.render_glyph();
+    const bool outline = ftw.load_outline(glyph_index);
+    if(!outline) {
+        ftw.load_glyph(glyph_index);
+    }
+    
+    // The analytic engine (and MSDF, which is built on it) works on the
+    // outline itself and never rasterizes.
+    const bool analytic = (sdf_scale > 1 && (dm_opts.engine == DM_ENGINE_ANALYTIC || dm_opts.msdf) &&
+                           outline);
+    // Run-length input skips the bitmap as well; it feeds the sampled engine.
+    const bool spans = (sdf_scale > 1 && !analytic && dm_opts.spans &&
+                        dm_opts.engine == DM_ENGINE_SAMPLED && outline);
+    const bool measure = (sdf_scale > 1 && target.output == GLYPH_MEASURE);
+    // Banded mode renders and transforms the hi-res glyph a band at a time
+    // (narrow-band transform only).
+    const bool banded = (dm_opts.band_rows > 0 && !spans && dm_opts.engine != DM_ENGINE_SAMPLED);
 
     glyph new_glyph;
     
     new_glyph.charcode = charcode;
-        
-    fbitmap<unsigned char> bmp(ftw.glyph()->bitmap.width, ftw.glyph()->bitmap.rows, (unsigned char)0);
-
-    // Copy the face bitmap into the bmp data. Freetype returns bitmaps with "pitch",
-    // which is the number of bytes per row and which might be larger than the width.
-
-    int ptch = ftw.glyph()->bitmap.pitch;
-    unsigned char *buf = ftw.glyph()->bitmap.buffer;
+    new_glyph.sdf_scale = sdf_scale;
     
-    for( int b_row = 0; b_row < ftw.glyph()->bitmap.rows; ++b_row )
-    {
-        for( int b_col = 0; b_col < ftw.glyph()->bitmap.width; ++b_col )
-        {
-            int row_in_array = (ftw.glyph()->bitmap.rows-1)-b_row;
-            unsigned char buf_byte = buf[row_in_array*ptch+b_col];
-            fbmp::set(bmp, b_col, b_row, buf_byte);
-        }
+    // Placement and size of the high-res glyph bitmap, in pixels.
+    int bitmap_left, bitmap_top, bitmap_width, bitmap_rows;
+    // Unrounded glyph box and advance, in 26.6 pixels.
+    FT_Pos glyph_width, glyph_height, glyph_advance;
+    
+    if(outline) {
+        
+        // Same box FreeType would give the rendered bitmap.
+        FT_BBox cbox;
+        FT_Outline_Get_CBox(ftw.outline(), &cbox);
+        glyph_width = cbox.xMax - cbox.xMin;
+        glyph_height = cbox.yMax - cbox.yMin;
+        glyph_advance = ftw.outline_advance();
+        bitmap_left = (int)std::floor(cbox.xMin/64.0);
+        bitmap_top = (int)std::ceil(cbox.yMax/64.0);
+        bitmap_width = (int)std::ceil(cbox.xMax/64.0) - bitmap_left;
+        bitmap_rows = bitmap_top - (int)std::floor(cbox.yMin/64.0);
+        
+    } else {
+        
+        ftw.render_glyph();
+        
+        bitmap_left = ftw.glyph()->bitmap_left;
+        bitmap_top = ftw.glyph()->bitmap_top;
+        bitmap_width = ftw.glyph()->bitmap.width;
+        bitmap_rows = ftw.glyph()->bitmap.rows;
+        glyph_width = ftw.glyph()->metrics.width;
+        glyph_height = ftw.glyph()->metrics.height;
+        glyph_advance = ftw.glyph()->advance.x;
     }
     
     // Create a reasonable padding value...
@@ -258,14 +688,32 @@ glyph load_glyph(ftwrapper & ftw, FT_ULong charcode, int font_size, int sdf_scal
     
     const int master_x_pad = final_x_pad*2;
     const int master_y_pad = final_y_pad*2;
+    
+    // Size of the final (padded, low-res) glyph bitmap.
+    const int lo_width = bitmap_width/sdf_scale + final_x_pad*2;
+    const int lo_height = bitmap_rows/sdf_scale + final_y_pad*2;
+    
+    // With GLYPH_ATLAS, the glyph's rectangle in the atlas.
+    dm_byte_window window = { NULL, 0, 0, 0, 0, 0 };
+    const bool to_atlas = (sdf_scale > 1 && target.output == GLYPH_ATLAS);
+    if(to_atlas) {
+        if(lo_width != target.width || lo_height != target.height) {
+            std::cout << "Fatal error: glyph does not match its packed size!" << std::endl;
+            exit(1);
+        }
+        fbitmap<unsigned char> & atlas = *target.atlas;
+        window.data = atlas.data.data() + (atlas.height - lo_height - target.y)*atlas.width + target.x;
+        window.stride = atlas.width;
+        window.width = lo_width;
+        window.height = lo_height;
+    }
 
     if (sdf_scale==1) {
         
-        // Just create and return a dummy (padded) bitmap to use in packing.
-        
-        fbitmap<unsigned char> lo_bmp(bmp.width + final_x_pad*2, bmp.height + final_y_pad*2, (unsigned char)0);
+        // Just size a dummy (padded) bitmap to use in packing; it is never drawn.
         
-        new_glyph.bmp = lo_bmp;
+        new_glyph.bmp.width = bitmap_width + final_x_pad*2;
+        new_glyph.bmp.height = bitmap_rows + final_y_pad*2;
         new_glyph.bbox_height += final_y_pad*2; // we pad on both sides of the bmp...
         new_glyph.bbox_width += final_x_pad*2;  // I only make this note because I forgot why I multiplied times 2 :)
         
@@ -273,75 +721,243 @@ glyph load_glyph(ftwrapper & ftw, FT_ULong charcode, int font_size, int sdf_scal
         
         return new_glyph;
         
-    } else {
+    } else if (measure) {
         
-        // The bitmap loaded above (new_glyph.bmp) is a hires bitmap. Render at high-res,
-        // then downsample into a bmp reduced by the scale factor.
+        new_glyph.bmp.width = lo_width;
+        new_glyph.bmp.height = lo_height;
         
-        fbitmap<double> sdf_bmp;
+    } else if (analytic) {
         
-        {
-            int x_pad =master_x_pad*sdf_scale;
-            int y_pad =master_y_pad*sdf_scale;
+        // Evaluate the distance field from the outline at the centers of the
+        // low-res texels only.
+        
+        outline_shape shape;
+        if(!outline_shape_from_ft(ftw.outline(), shape)) {
+            std::cerr << "Error: could not decompose the glyph outline." << std::endl;
+            exit(1);
+        }
+        
+        fbitmap<float> & d_bmp = workspace.lo_res;
+        d_bmp.width = lo_width;
+        d_bmp.height = lo_height;
+        fbmp::clear(d_bmp, 0.0f);
+        
+        const float origin_x = bitmap_left - final_x_pad*sdf_scale;
+        const float origin_y = bitmap_top + final_y_pad*sdf_scale;
+        
+        new_glyph.texel_x0 = (origin_x + 0.5f*sdf_scale)/sdf_scale;
+        new_glyph.texel_y0 = (origin_y - 0.5f*sdf_scale)/sdf_scale;
+        new_glyph.texel_dx = 1;
+        new_glyph.texel_dy = 1;
+        
+        if(dm_opts.msdf) {
             
-            sdf_bmp.height = bmp.height+y_pad*2;
-            sdf_bmp.width = bmp.width+x_pad*2;
-            fbmp::clear(sdf_bmp, 0.0);
+            std::vector<float> & rgb = workspace.rgb;
+            rgb.resize(d_bmp.data.size()*3);
+            outline_color_edges(shape, 3.0f);
+            outline_msdf(shape, rgb.data(), d_bmp.data.data(), d_bmp.width, d_bmp.height,
+                         origin_x, origin_y, sdf_scale, final_x_pad*sdf_scale, dm_opts.threads);
             
-            // Copy high resolution bitmap with padding and normalize values
-            for( int j=0; j < bmp.height; ++j )
+            rgb_pixel black = { 0, 0, 0 };
+            fbitmap<rgb_pixel> msdf_bmp(d_bmp.width, d_bmp.height, black);
+            for( size_t i=0; i < msdf_bmp.data.size(); ++i )
             {
-                for( int i=0; i < bmp.width; ++i )
+                msdf_bmp.data[i].r = (unsigned char)std::round(255*(1.0-rgb[i*3+0]));
+                msdf_bmp.data[i].g = (unsigned char)std::round(255*(1.0-rgb[i*3+1]));
+                msdf_bmp.data[i].b = (unsigned char)std::round(255*(1.0-rgb[i*3+2]));
+            }
+            new_glyph.msdf = msdf_bmp;
+            
+        } else {
+            
+            outline_sdf(shape, d_bmp.data.data(), d_bmp.width, d_bmp.height,
+                        origin_x, origin_y, sdf_scale, final_x_pad*sdf_scale, dm_opts.threads);
+        }
+        
+        if(to_atlas) {
+            for( int j=0; j < lo_height; ++j )
+            {
+                const float *row = &d_bmp.data[j*lo_width];
+                unsigned char *d = window.data + j*window.stride;
+                for( int i=0; i < lo_width; ++i )
                 {
-                    fbmp::set(sdf_bmp, i+x_pad, j+y_pad, fbmp::get(bmp, i, j)/255.0);
+                    d[i] = (unsigned char)std::round(255*(1.0-row[i]));
                 }
             }
+        } else {
+            fbitmap<unsigned char> lo_bmp(d_bmp.width, d_bmp.height, (unsigned char)0);
+            for( size_t i=0; i < d_bmp.data.size(); ++i )
+            {
+                lo_bmp.data[i] = (unsigned char)std::round(255*(1.0-d_bmp.data[i]));
+            }
             
+            new_glyph.bmp = lo_bmp;
         }
         
-        // Compute distance map
-        make_distance_map( sdf_bmp.data.data() , sdf_bmp.width , sdf_bmp.height );
+    } else {
         
-        // Allocate low resolution buffer:
-        fbitmap<double> d_bmp;
-        d_bmp.height = ftw.glyph()->bitmap.rows/sdf_scale + master_x_pad*2;
-        d_bmp.width = ftw.glyph()->bitmap.width/sdf_scale + master_y_pad*2;
-        fbmp::clear(d_bmp, 0.0);
+        // Render at high-res, then downsample into a bmp reduced by the scale factor.
         
-        // Scale down highres buffer into lowres buffer
-        resize( sdf_bmp.data.data(), sdf_bmp.width , sdf_bmp.height,
-               d_bmp.data.data(), d_bmp.width, d_bmp.height );
+        fbitmap<float> & sdf_bmp = workspace.hi_res;
         
-        // Convert the (double *) lowres buffer into a (unsigned char *) buffer and
-        // rescale values between 0 and 255.
-        fbitmap<unsigned char> lo_bmp;
-        lo_bmp.height = ftw.glyph()->bitmap.rows/sdf_scale + final_y_pad*2 ;
-        lo_bmp.width = ftw.glyph()->bitmap.width/sdf_scale + final_x_pad*2 ;
-        fbmp::clear(lo_bmp, (unsigned char)0);
+        // In banded mode, the padded hi-res glyph (like sdf_bmp below) is
+        // rendered by the distance map, band by band.
+        glyph_band band = { &ftw, outline, bitmap_left, bitmap_top, bitmap_width, bitmap_rows,
+                            master_x_pad*sdf_scale, master_y_pad*sdf_scale };
+        dm_band_source<float> band_source = { glyph_band::render, &band };
+        const int band_width = bitmap_width + band.x_pad*2;
+        const int band_height = bitmap_rows + band.y_pad*2;
+        
+        if(spans) {
+            
+            // Runs straight from the rasterizer, padded like sdf_bmp below.
+            ftw.render_spans(workspace.spans, bitmap_left, bitmap_top, bitmap_width, bitmap_rows,
+                             master_x_pad*sdf_scale, master_y_pad*sdf_scale);
+            
+        } else if(!banded) {
+            int x_pad =master_x_pad*sdf_scale;
+            int y_pad =master_y_pad*sdf_scale;
+            
+            sdf_bmp.height = bitmap_rows+y_pad*2;
+            sdf_bmp.width = bitmap_width+x_pad*2;
+            fbmp::clear(sdf_bmp, 0.0f);
+            
+            if(outline) {
+                
+                // Coverage straight from the rasterizer, already padded and normalized.
+                ftw.render_coverage(sdf_bmp.data.data(), sdf_bmp.width, bitmap_left, bitmap_top,
+                                    bitmap_width, bitmap_rows, x_pad, y_pad);
+                
+            } else {
+                
+                // Copy the slot's bitmap with padding and normalize values. Freetype
+                // returns bitmaps with "pitch", which is the number of bytes per row
+                // and which might be larger than the width. Both are stored top row first.
+                int ptch = ftw.glyph()->bitmap.pitch;
+                const unsigned char *buf = ftw.glyph()->bitmap.buffer;
+                
+                for( int j=0; j < bitmap_rows; ++j )
+                {
+                    float *row = &sdf_bmp.data[(j+y_pad)*sdf_bmp.width + x_pad];
+                    for( int i=0; i < bitmap_width; ++i )
+                    {
+                        row[i] = buf[j*ptch+i]/255.0f;
+                    }
+                }
+            }
+        }
+        
+        // Size of the low resolution field; the final bitmap is its middle.
+        const int d_height = bitmap_rows/sdf_scale + master_x_pad*2;
+        const int d_width = bitmap_width/sdf_scale + master_y_pad*2;
         
         int x_pad_diff = master_x_pad - final_x_pad;
         int y_pad_diff = master_y_pad - final_y_pad;
-
-        for( int j=0; j < (lo_bmp.height); ++j )
-        {
-            for( int i=0; i < (lo_bmp.width); ++i )
+        
+        // The resize maps the whole padded hi-res image onto the low-res
+        // field, so a texel is not always exactly sdf_scale pixels wide.
+        const float ratio_x = (float)(bitmap_width + master_x_pad*sdf_scale*2)/d_width;
+        const float ratio_y = (float)(bitmap_rows + master_y_pad*sdf_scale*2)/d_height;
+        new_glyph.texel_x0 = (bitmap_left - master_x_pad*sdf_scale + (x_pad_diff + 0.5f)*ratio_x)/sdf_scale;
+        new_glyph.texel_y0 = (bitmap_top + master_y_pad*sdf_scale - (y_pad_diff + 0.5f)*ratio_y)/sdf_scale;
+        new_glyph.texel_dx = ratio_x/sdf_scale;
+        new_glyph.texel_dy = ratio_y/sdf_scale;
+        
+        // Compute distance map. In narrow-band and sampled mode only the final
+        // padding (in hi-res pixels) is needed; everything beyond it is clamped.
+        dm_options glyph_dm_opts = dm_opts;
+        glyph_dm_opts.spread = final_x_pad*sdf_scale;
+        
+        if(to_atlas) {
+            
+            // Resample only the final bitmap's pixels, straight into the atlas.
+            window.x0 = x_pad_diff;
+            window.y0 = y_pad_diff;
+            
+            if(spans) {
+                make_span_distance_map( workspace.spans, window, d_width, d_height,
+                                        workspace.dm, glyph_dm_opts );
+            } else if(banded) {
+                make_banded_distance_map( band_source, band_width, band_height,
+                                          window, d_width, d_height, workspace.dm, glyph_dm_opts );
+            } else if(dm_opts.engine == DM_ENGINE_SAMPLED) {
+                make_sampled_distance_map( sdf_bmp.data.data(), sdf_bmp.width, sdf_bmp.height,
+                                           window, d_width, d_height,
+                                           workspace.dm, glyph_dm_opts );
+            } else {
+                make_distance_map( sdf_bmp.data.data() , sdf_bmp.width , sdf_bmp.height,
+                                   workspace.dm, glyph_dm_opts, stats );
+                resize( sdf_bmp.data.data(), sdf_bmp.width , sdf_bmp.height,
+                       window, d_width, d_height, dm_opts.filter );
+            }
+            
+        } else {
+            
+            // Size the low resolution buffer:
+            fbitmap<float> & d_bmp = workspace.lo_res;
+            d_bmp.height = d_height;
+            d_bmp.width = d_width;
+            fbmp::clear(d_bmp, 0.0f);
+            
+            if(spans) {
+                
+                make_span_distance_map( workspace.spans, d_bmp.data.data(), d_bmp.width, d_bmp.height,
+                                        workspace.dm, glyph_dm_opts );
+                
+            } else if(banded) {
+                
+                make_banded_distance_map( band_source, band_width, band_height,
+                                          d_bmp.data.data(), d_bmp.width, d_bmp.height,
+                                          workspace.dm, glyph_dm_opts );
+                
+            } else if(dm_opts.engine == DM_ENGINE_SAMPLED) {
+                
+                // Evaluate the distance map only where the downsampling reads it.
+                make_sampled_distance_map( sdf_bmp.data.data(), sdf_bmp.width, sdf_bmp.height,
+                                           d_bmp.data.data(), d_bmp.width, d_bmp.height,
+                                           workspace.dm, glyph_dm_opts );
+                
+            } else {
+                
+                make_distance_map( sdf_bmp.data.data() , sdf_bmp.width , sdf_bmp.height,
+                                   workspace.dm, glyph_dm_opts, stats );
+                
+                // Scale down highres buffer into lowres buffer
+                resize( sdf_bmp.data.data(), sdf_bmp.width , sdf_bmp.height,
+                       d_bmp.data.data(), d_bmp.width, d_bmp.height, dm_opts.filter );
+            }
+            
+            // Convert the (float *) lowres buffer into a (unsigned char *) buffer and
+            // rescale values between 0 and 255.
+            fbitmap<unsigned char> lo_bmp;
+            lo_bmp.height = lo_height;
+            lo_bmp.width = lo_width;
+            fbmp::clear(lo_bmp, (unsigned char)0);
+            
+            for( int j=0; j < (lo_bmp.height); ++j )
             {
-                double v = fbmp::get(d_bmp, i+x_pad_diff, j+y_pad_diff);
-                fbmp::set(lo_bmp, i, j, (unsigned char)std::round(255*(1.0-v)));
+                for( int i=0; i < (lo_bmp.width); ++i )
+                {
+                    float v = fbmp::get(d_bmp, i+x_pad_diff, j+y_pad_diff);
+                    fbmp::set(lo_bmp, i, j, (unsigned char)std::round(255*(1.0-v)));
+                }
             }
+            
+            new_glyph.bmp = lo_bmp;
         }
+    }
+    
+    if (sdf_scale > 1) {
         
-        new_glyph.bmp = lo_bmp;
-        
-        new_glyph.bearing_x = ftw.glyph()->bitmap_left; // current pen to leftmost border of bitmap, in pixels
-        new_glyph.bearing_y = ftw.glyph()->bitmap_top; // current pen to top of bitmap, in pixels
+        new_glyph.bearing_x = bitmap_left; // current pen to leftmost border of bitmap, in pixels
+        new_glyph.bearing_y = bitmap_top; // current pen to top of bitmap, in pixels
 
         // Distances are expressed in 26.6 grid-fitted pixels (which means that the values are
         // multiples of 64). For scalable formats, this means that the design kerning distance
         // is scaled, then rounded.
-        new_glyph.advance_x = ftw.glyph()->advance.x/64.0f;        // expressed in 1/64th of pixels
-        new_glyph.bbox_width = ftw.glyph()->metrics.width/64.0f;   // expressed in 1/64th of pixels
-        new_glyph.bbox_height = ftw.glyph()->metrics.height/64.0f; // expressed in 1/64th of pixels
+        new_glyph.advance_x = glyph_advance/64.0f;   // expressed in 1/64th of pixels
+        new_glyph.bbox_width = glyph_width/64.0f;    // expressed in 1/64th of pixels
+        new_glyph.bbox_height = glyph_height/64.0f;  // expressed in 1/64th of pixels
         
         // Scale down dimensions by sdf_scale...
         
@@ -371,44 +987,247 @@ glyph load_glyph(ftwrapper & ftw, FT_ULong charcode, int font_size, int sdf_scal
     return new_glyph;
 };
 
+/**
+ * Prints the pass counts of a glyph's distance transform.
+ */
+void print_edt_stats(edt_stats const & stats) {
+    
+    std::cout << "  " << stats.passes << " passes, updates per pass:";
+    for(size_t i = 0; i < stats.changed.size(); ++i) {
+        std::cout << " " << stats.changed[i];
+    }
+    if(stats.rows_skipped > 0) {
+        std::cout << "; " << stats.rows_skipped << " row scans skipped";
+    }
+    if(!stats.converged) {
+        std::cout << " (stopped before converging)";
+    }
+    std::cout << std::endl;
+    if(stats.table_checked) {
+        std::cout << "  edge table error: max " << stats.table_error_max
+                  << " px, mean " << stats.table_error_mean << " px" << std::endl;
+    }
+}
+
 /**
  * Load all glyphs with character codes in v_charcodes from a font face.
+ * The glyphs are loaded one after another and share one workspace.
+ * With output == GLYPH_MEASURE only the glyphs' bitmap sizes are set.
+ * Each glyph's sdf_scale comes from scales.
  */
 std::map<uint32_t, glyph> load_glyphs(ftwrapper & ftw,
-                                      int font_size,
-                                      int sdf_scale,
-                                      std::vector<uint32_t> const & v_charcodes) {
+                                      float font_size,
+                                      scale_policy const & scales,
+                                      std::vector<uint32_t> const & v_charcodes,
+                                      dm_options const & dm_opts,
+                                      bool print_stats = false,
+                                      glyph_output output = GLYPH_BITMAP) {
     
     std::map<uint32_t, glyph> glyphs;
+    glyph_workspace workspace;
+    glyph_target target;
+    target.output = output;
         
     for(int i = 0; i<v_charcodes.size(); ++i) {
         FT_ULong charcode = v_charcodes[i];
-        if(sdf_scale>1) {
+        int sdf_scale = scales.scale_for(glyph_extent(ftw, ftw.get_char_index(charcode), font_size));
+        if(sdf_scale>1 && output != GLYPH_MEASURE) {
             std::string ccode;
             utf_append(charcode, ccode);
             std::cout << "Loading 0x" << std::hex << charcode << std::dec << "' (" << ccode << ")..." << std::endl;
         }
-        glyph new_glyph = load_glyph(ftw, charcode, font_size, sdf_scale);
+        edt_stats stats;
+        glyph new_glyph = load_glyph(ftw, charcode, font_size, sdf_scale, dm_opts, workspace,
+                                     &stats, target);
+        if(print_stats && stats.passes > 0) {
+            print_edt_stats(stats);
+        }
         glyphs[new_glyph.charcode] = new_glyph;
     }
     
     return glyphs;
 }
 
+/**
+ * Renders the distance fields of measured and packed glyphs (see
+ * load_glyphs() and pack_bin()) straight into their rectangles of
+ * final_bitmap, each with the sdf_scale it was measured with. Glyphs are
+ * shared out among "jobs" threads (0 = all cores), each with its own face
+ * from faces and its own workspace; the rectangles don't overlap, so the
+ * threads write to the atlas without locking. With more than one job the
+ * distance map engines run single-threaded.
+ */
+void render_glyphs(face_pool & faces,
+                   std::map<uint32_t, glyph> & glyphs,
+                   fbitmap<unsigned char> & final_bitmap,
+                   float font_size,
+                   std::vector<uint32_t> const & v_charcodes,
+                   dm_options const & dm_opts,
+                   bool print_stats = false,
+                   int jobs = 1) {
+    
+    std::vector<std::pair<uint32_t, glyph const *> > todo;
+    for(int i = 0; i<v_charcodes.size(); ++i) {
+        todo.push_back(std::make_pair(v_charcodes[i], &glyphs[v_charcodes[i]]));
+    }
+    
+    if(jobs == 0) {
+        jobs = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    jobs = std::max(1, std::min(jobs, (int)todo.size()));
+    dm_options glyph_opts = dm_opts;
+    if(jobs > 1) {
+        glyph_opts.threads = 1;
+    }
+    
+    std::atomic<int> next(0);
+    std::mutex log;
+    
+    faces.set_pixel_size(font_size);
+    parallel_for(0, jobs, jobs, [&](int, int) {
+        face_pool::lease ftw = faces.checkout();
+        glyph_workspace workspace;
+        glyph_target target;
+        target.output = GLYPH_ATLAS;
+        target.atlas = &final_bitmap;
+        
+        // Glyph costs vary too much for fixed ranges; take them one by one.
+        for(int i = next++; i < (int)todo.size(); i = next++) {
+            FT_ULong charcode = todo[i].first;
+            glyph const & g = *todo[i].second;
+            {
+                std::lock_guard<std::mutex> lock(log);
+                std::string ccode;
+                utf_append(charcode, ccode);
+                std::cout << "Loading 0x" << std::hex << charcode << std::dec << "' (" << ccode << ")..." << std::endl;
+            }
+            target.x = g.atlas_x;
+            target.y = g.atlas_y;
+            target.width = g.bmp.width;
+            target.height = g.bmp.height;
+            edt_stats stats;
+            load_glyph(*ftw, charcode, font_size, g.sdf_scale, glyph_opts, workspace, &stats, target);
+            if(print_stats && stats.passes > 0) {
+                std::lock_guard<std::mutex> lock(log);
+                print_edt_stats(stats);
+            }
+        }
+    });
+}
+
+
+/**
+ * Mean difference, in levels, between the distance fields of two
+ * renderings of a glyph: at each of ref's texels inside g's texel grid,
+ * against g bilinearly interpolated there.
+ */
+float glyph_field_error(glyph const & g, glyph const & ref) {
+    double sum = 0;
+    size_t count = 0;
+    for( int j=0; j < ref.bmp.height; ++j )
+    {
+        const float v = (g.texel_y0 - (ref.texel_y0 - j*ref.texel_dy))/g.texel_dy;
+        const int v0 = (int)std::floor(v);
+        if(v0 < 0 || v0+1 >= g.bmp.height) {
+            continue;
+        }
+        const float fv = v - v0;
+        const unsigned char *row0 = &g.bmp.data[v0*g.bmp.width];
+        const unsigned char *row1 = row0 + g.bmp.width;
+        for( int i=0; i < ref.bmp.width; ++i )
+        {
+            const float u = (ref.texel_x0 + i*ref.texel_dx - g.texel_x0)/g.texel_dx;
+            const int u0 = (int)std::floor(u);
+            if(u0 < 0 || u0+1 >= g.bmp.width) {
+                continue;
+            }
+            const float fu = u - u0;
+            const float top = row0[u0] + fu*(row0[u0+1] - row0[u0]);
+            const float bottom = row1[u0] + fu*(row1[u0+1] - row1[u0]);
+            sum += std::fabs(top + fv*(bottom - top) - ref.bmp.data[j*ref.bmp.width+i]);
+            ++count;
+        }
+    }
+    return count > 0 ? (float)(sum/count) : 0.0f;
+}
+
+/**
+ * Finds the smallest scale_policy::hires_px (see scale_policy) at which
+ * no glyph's distance field differs from its field at scales.max_scale by
+ * more than max_error levels (out of 255) on average. For each glyph this
+ * tries factors from scales.min_scale up and keeps the first within the
+ * budget; hires_px is the largest resulting factor times glyph extent.
+ * The fields' texel grids differ slightly between factors, so each
+ * reference texel is compared with the other field interpolated at its
+ * center (see glyph_field_error()).
+ */
+int calibrate_hires_px(ftwrapper & ftw,
+                       float font_size,
+                       scale_policy const & scales,
+                       std::vector<uint32_t> const & v_charcodes,
+                       dm_options const & dm_opts,
+                       float max_error) {
+    
+    static const int factors[] = { 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64 };
+    const int num_factors = sizeof(factors)/sizeof(factors[0]);
+    
+    glyph_workspace workspace;
+    int hires_px = 0;
+    
+    for(int i = 0; i<v_charcodes.size(); ++i) {
+        FT_ULong charcode = v_charcodes[i];
+        float extent = glyph_extent(ftw, ftw.get_char_index(charcode), font_size);
+        
+        glyph ref = load_glyph(ftw, charcode, font_size, scales.max_scale, dm_opts, workspace);
+        
+        int needed = scales.max_scale;
+        float error = 0;
+        for(int k = 0; k < num_factors && factors[k] < scales.max_scale; ++k) {
+            if(factors[k] < scales.min_scale) {
+                continue;
+            }
+            glyph g = load_glyph(ftw, charcode, font_size, factors[k], dm_opts, workspace);
+            error = glyph_field_error(g, ref);
+            if(error <= max_error) {
+                needed = factors[k];
+                break;
+            }
+        }
+        
+        std::string ccode;
+        utf_append(charcode, ccode);
+        std::cout << "Calibrating '" << ccode << "': " << extent << " pixels, scale " << needed
+                  << " (mean error " << error << ")." << std::endl;
+        
+        hires_px = std::max(hires_px, (int)std::ceil(needed*extent));
+    }
+    
+    return hires_px;
+}
 
 /**
  * Packs a bitmap (final_bitmap) using rectangles from a set (well, a map) of glyphs.
+ * If final_msdf is given, the glyphs' multi-channel bitmaps are copied into it
+ * at the same positions. Without blit only the positions are assigned, for
+ * glyphs that were just measured.
  */
 
 bool pack_bin (std::map<uint32_t, glyph> & glyphs,
                fbitmap<unsigned char> & final_bitmap,
                std::vector<uint32_t> const & v_charcodes,
-               bool print_stats) {
+               bool print_stats,
+               fbitmap<rgb_pixel> * final_msdf = NULL,
+               bool blit = true) {
 
     bool packed_successfully = false;
     
     fbmp::clear(final_bitmap, (unsigned char)0);
     
+    if(final_msdf) {
+        rgb_pixel black = { 0, 0, 0 };
+        fbmp::clear(*final_msdf, black);
+    }
+    
     int numToPack = v_charcodes.size();
     
     int numPacked = 0; // The number of rectangles packed successfully, for printing statistics at the end.
@@ -481,7 +1300,9 @@ bool pack_bin (std::map<uint32_t, glyph> & glyphs,
 #endif
             numPacked+=1;
             
-            if(!fbmp::replace_part(final_bitmap, g.bmp, output.x, output.y)) {
+            if(blit &&
+               (!fbmp::replace_part(final_bitmap, g.bmp, output.x, output.y) ||
+                (final_msdf && !fbmp::replace_part(*final_msdf, g.msdf, output.x, output.y)))) {
                 std::cout << "Fatal error: pack into final bitmap failed!" << std::endl;
                 exit(1);
             } else {
@@ -489,6 +1310,8 @@ bool pack_bin (std::map<uint32_t, glyph> & glyphs,
                 g.t0 = t0;
                 g.s1 = s1;
                 g.t1 = t1;
+                g.atlas_x = output.x;
+                g.atlas_y = output.y;
             }
         }
 #ifdef VERBOSENESS
@@ -518,6 +1341,58 @@ bool pack_bin (std::map<uint32_t, glyph> & glyphs,
     return packed_successfully;
 }
 
+/**
+ * Finds the largest font size, a multiple of size_step/64 pixels, at
+ * which all glyphs pack into final_bitmap: doubling from 4 pixels until
+ * packing fails, then bisecting. The search only measures glyphs (see
+ * load_glyph() with sdf_scale 1), and assumes that a size that does not
+ * fit is not followed by one that does. Returns 0 if even 4 pixels fail.
+ */
+float search_font_size(ftwrapper & ftw,
+                       fbitmap<unsigned char> & final_bitmap,
+                       std::vector<uint32_t> const & v_charcodes,
+                       dm_options const & dm_opts,
+                       int size_step) {
+    
+    std::map<uint32_t, glyph> m_glyphs;
+    int iterations = 0;
+    
+    // Sizes in 1/64 pixels, on the size_step grid.
+    int lo = (4*64 + size_step - 1)/size_step*size_step;
+    int hi = lo*2;
+    
+    m_glyphs = load_glyphs(ftw, lo/64.0f, scale_policy(1), v_charcodes, dm_opts);
+    ++iterations;
+    if(!pack_bin (m_glyphs, final_bitmap, v_charcodes, false, NULL, false)) {
+        return 0;
+    }
+    
+    for(;;) {
+        m_glyphs = load_glyphs(ftw, hi/64.0f, scale_policy(1), v_charcodes, dm_opts);
+        ++iterations;
+        if(!pack_bin (m_glyphs, final_bitmap, v_charcodes, false, NULL, false)) {
+            break;
+        }
+        lo = hi;
+        hi *= 2;
+    }
+    
+    while(hi - lo > size_step) {
+        int mid = lo + (hi - lo)/size_step/2*size_step;
+        m_glyphs = load_glyphs(ftw, mid/64.0f, scale_policy(1), v_charcodes, dm_opts);
+        ++iterations;
+        if(pack_bin (m_glyphs, final_bitmap, v_charcodes, false, NULL, false)) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    
+    std::cout << "Found font size in " << iterations << " packing attempts." << std::endl;
+    
+    return lo/64.0f;
+}
+
 std::string file_to_font_name(std::string filename) {
 #ifdef _WIN32
     char delimiter = '\\';
@@ -547,20 +1422,145 @@ int main( int argc, char **argv )
     
     std::string font_filename;
     int bitmap_size;
+    
+    dm_options dm_opts;
+    bool print_stats = false;
+    int size_step = 1; // font size search resolution, in 1/64 pixels
+    scale_policy scales;
+    float calibrate_error = 0; // with calibration, mean error budget in levels
+    int jobs = 1; // threads rendering glyphs into the atlas, 0 = all cores
 
     // *** Process Args
     
-    if(argc!=3) {
-        std::cerr << "Arguments required: '" << argv[0] << " fontname.ttf bitmap_size'" << std::endl;
+    std::vector<std::string> positional;
+    bool args_ok = true;
+    
+    for(int i = 1; i < argc; i+=1) {
+        std::string arg = argv[i];
+        bool has_value = (i+1 < argc);
+        if(arg == "-engine" && has_value) {
+            std::string engine = argv[++i];
+            if(engine == "edtaa3") {
+                dm_opts.engine = DM_ENGINE_EDTAA3;
+            } else if(engine == "separable") {
+                dm_opts.engine = DM_ENGINE_SEPARABLE;
+            } else if(engine == "analytic") {
+                dm_opts.engine = DM_ENGINE_ANALYTIC;
+            } else if(engine == "sampled") {
+                dm_opts.engine = DM_ENGINE_SAMPLED;
+            } else {
+                std::cerr << "Unknown engine '" << engine << "'." << std::endl;
+                args_ok = false;
+            }
+        } else if(arg == "-layout" && has_value) {
+            std::string layout = argv[++i];
+            if(layout == "packed") {
+                dm_opts.layout = DM_LAYOUT_PACKED;
+            } else if(layout == "planar") {
+                dm_opts.layout = DM_LAYOUT_PLANAR;
+            } else {
+                std::cerr << "Unknown layout '" << layout << "'." << std::endl;
+                args_ok = false;
+            }
+        } else if(arg == "-filter" && has_value) {
+            std::string filter = argv[++i];
+            if(filter == "mitchell") {
+                dm_opts.filter = DM_FILTER_MITCHELL;
+            } else if(filter == "box") {
+                dm_opts.filter = DM_FILTER_BOX;
+            } else {
+                std::cerr << "Unknown filter '" << filter << "'." << std::endl;
+                args_ok = false;
+            }
+        } else if(arg == "-maxpasses" && has_value) {
+            dm_opts.limits.max_passes = std::atoi(argv[++i]);
+        } else if(arg == "-dirtyrows") {
+            dm_opts.limits.dirty_rows = true;
+        } else if(arg == "-edgetable") {
+            dm_opts.edge_table = true;
+        } else if(arg == "-checkedgetable") {
+            dm_opts.check_edge_table = true;
+            print_stats = true;
+        } else if(arg == "-stats") {
+            print_stats = true;
+        } else if(arg == "-msdf") {
+            dm_opts.msdf = true;
+        } else if(arg == "-spans") {
+            dm_opts.spans = true;
+            dm_opts.engine = DM_ENGINE_SAMPLED;
+        } else if(arg == "-narrowband") {
+            dm_opts.narrow_band = true;
+        } else if(arg == "-bandrows" && has_value) {
+            dm_opts.band_rows = std::atoi(argv[++i]);
+            dm_opts.narrow_band = true;
+        } else if(arg == "-threads" && has_value) {
+            dm_opts.threads = std::atoi(argv[++i]);
+        } else if(arg == "-jobs" && has_value) {
+            jobs = std::atoi(argv[++i]);
+        } else if(arg == "-scale" && has_value) {
+            scales.fixed_scale = std::atoi(argv[++i]);
+            if(scales.fixed_scale < 2) {
+                std::cerr << "Scale must be at least 2." << std::endl;
+                args_ok = false;
+            }
+        } else if(arg == "-hirespx" && has_value) {
+            scales.hires_px = std::atoi(argv[++i]);
+        } else if(arg == "-calibrate" && has_value) {
+            calibrate_error = std::atof(argv[++i]);
+            if(calibrate_error <= 0) {
+                std::cerr << "Calibration error budget must be positive." << std::endl;
+                args_ok = false;
+            }
+        } else if(arg == "-sizestep" && has_value) {
+            size_step = (int)std::round(std::atof(argv[++i])*64);
+            if(size_step < 1) {
+                std::cerr << "Size step must be at least 1/64 pixel." << std::endl;
+                args_ok = false;
+            }
+        } else if(arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option '" << arg << "'." << std::endl;
+            args_ok = false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    
+    if(!args_ok || positional.size()!=2) {
+        std::cerr << "Arguments required: '" << argv[0] << " [options] fontname.ttf bitmap_size'" << std::endl;
+        std::cerr << "Options:" << std::endl;
+        std::cerr << "  -engine edtaa3|separable|analytic|sampled" << std::endl;
+        std::cerr << "                            distance field engine (default edtaa3)" << std::endl;
+        std::cerr << "  -layout packed|planar     edtaa3 state layout (default planar)" << std::endl;
+        std::cerr << "  -filter mitchell|box      downsampling filter (default mitchell)" << std::endl;
+        std::cerr << "  -maxpasses n              stop the edtaa3 sweeps after n passes (default 0 = no limit)" << std::endl;
+        std::cerr << "  -dirtyrows                edtaa3: only rescan rows next to rows that changed" << std::endl;
+        std::cerr << "  -edgetable                edtaa3: use a lookup table for the edge distance term" << std::endl;
+        std::cerr << "  -checkedgetable           edtaa3: report the lookup table's error against the exact term" << std::endl;
+        std::cerr << "  -stats                    print edtaa3 pass counts for each glyph" << std::endl;
+        std::cerr << "  -msdf                     write a 3-channel multi-channel distance field" << std::endl;
+        std::cerr << "  -spans                    render glyphs as runs for the sampled engine (implies it)" << std::endl;
+        std::cerr << "  -narrowband               only compute distances within the padding band" << std::endl;
+        std::cerr << "  -bandrows n               narrow band, rendering glyphs n output rows at a time" << std::endl;
+        std::cerr << "  -threads n                threads for the separable engine (default 0 = all cores)" << std::endl;
+        std::cerr << "  -jobs n                   threads rendering glyphs into the atlas (default 1, 0 = all cores)" << std::endl;
+        std::cerr << "  -sizestep s               font size search resolution in pixels (default 1/64 = 0.015625)" << std::endl;
+        std::cerr << "  -scale n                  supersampling factor for every glyph (default 16)" << std::endl;
+        std::cerr << "  -hirespx n                per-glyph supersampling: render each glyph about n pixels large" << std::endl;
+        std::cerr << "  -calibrate e              find -hirespx for a mean error of e levels (out of 255), and use it" << std::endl;
         exit(0);
     } else {
-        font_filename = argv[1];
-        bitmap_size = std::atoi(argv[2]);
+        font_filename = positional[0];
+        bitmap_size = std::atoi(positional[1].c_str());
     }
 
     // *** Load Font
     
-    ftwrapper ftw(font_filename);
+    std::shared_ptr<font_data> fontdata = font_data::open(font_filename);
+    if(!fontdata) {
+        exit(1);
+    }
+    
+    ftwrapper ftw(fontdata);
     
     if (! ftw.valid ) {
         exit(0);
@@ -603,34 +1603,52 @@ int main( int argc, char **argv )
     // *** Pack Glyphs
     
     fbitmap<unsigned char> final_bitmap(bitmap_size, bitmap_size, (unsigned char)0);
-
-    int font_size = 2;
     
+    rgb_pixel black = { 0, 0, 0 };
+    fbitmap<rgb_pixel> final_msdf(bitmap_size, bitmap_size, black);
+
     bool packed_successfully = false;
     
     std::map<uint32_t, glyph> m_glyphs;
 
-    do {
-        font_size += 2;
-        m_glyphs = load_glyphs(ftw, font_size, 1, v_charcodes);
-        packed_successfully = pack_bin (m_glyphs, final_bitmap, v_charcodes, false);
-
-    } while(packed_successfully);
+    float font_size = search_font_size(ftw, final_bitmap, v_charcodes, dm_opts, size_step);
 
-    if(font_size == 4) {
-        std::cerr << "Font packing failure. Pack failed at " << font_size << " pixels. Stopping." << std::endl;
+    if(font_size == 0) {
+        std::cerr << "Font packing failure. Pack failed at 4 pixels. Stopping." << std::endl;
         exit(1);
     } else {
-        font_size-=2;
         
         // Okay, we have our good sizes. Now it's time to do the distance mapping...
         
-        int scale = 16;
-        
-        m_glyphs = load_glyphs(ftw, font_size, scale, v_charcodes);
+        if(calibrate_error > 0) {
+            scales.hires_px = calibrate_hires_px(ftw, font_size, scales, v_charcodes, dm_opts,
+                                                 calibrate_error);
+            std::cout << "Calibrated -hirespx " << scales.hires_px << " for a mean error of "
+                      << calibrate_error << " levels." << std::endl;
+        }
         
-        std::cout << "Packing at " << font_size << " pixels." << std::endl;
-        packed_successfully = pack_bin (m_glyphs, final_bitmap, v_charcodes, true);
+        if(dm_opts.msdf) {
+            
+            m_glyphs = load_glyphs(ftw, font_size, scales, v_charcodes, dm_opts, print_stats);
+            
+            std::cout << "Packing at " << font_size << " pixels." << std::endl;
+            packed_successfully = pack_bin (m_glyphs, final_bitmap, v_charcodes, true, &final_msdf);
+            
+        } else {
+            
+            // Measure and pack first, then compute each distance field
+            // straight into its place in the atlas.
+            m_glyphs = load_glyphs(ftw, font_size, scales, v_charcodes, dm_opts, false, GLYPH_MEASURE);
+            
+            std::cout << "Packing at " << font_size << " pixels." << std::endl;
+            packed_successfully = pack_bin (m_glyphs, final_bitmap, v_charcodes, true, NULL, false);
+            
+            if(packed_successfully) {
+                face_pool faces(fontdata, jobs == 0 ? (int)std::thread::hardware_concurrency() : jobs);
+                render_glyphs(faces, m_glyphs, final_bitmap, font_size, v_charcodes, dm_opts,
+                              print_stats, jobs);
+            }
+        }
     }
     
     if(!packed_successfully) {
@@ -727,12 +1745,23 @@ int main( int argc, char **argv )
     std::string bitmap_name(file_to_font_name(font_filename));
     bitmap_name+=".png";
        
-    if(stbi_write_png(bitmap_name.c_str(),
-                      final_bitmap.width,
-                      final_bitmap.height,
-                      1,
-                      final_bitmap.data.data(),
-                      final_bitmap.width)) {
+    int written = 0;
+    if(dm_opts.msdf) {
+        written = stbi_write_png(bitmap_name.c_str(),
+                                 final_msdf.width,
+                                 final_msdf.height,
+                                 3,
+                                 final_msdf.data.data(),
+                                 final_msdf.width*3);
+    } else {
+        written = stbi_write_png(bitmap_name.c_str(),
+                                 final_bitmap.width,
+                                 final_bitmap.height,
+                                 1,
+                                 final_bitmap.data.data(),
+                                 final_bitmap.width);
+    }
+    if(written) {
         std::cout << "Wrote " << bitmap_name << "." << std::endl;
     } else {
         std::cerr << "Write of " << bitmap_name << " FAILED." << std::endl;
@@ -758,6 +1787,9 @@ int main( int argc, char **argv )
         pjo["space_advance"] = picojson::value(space_advance);
         pjo["bitmap_width"] = picojson::value(float(final_bitmap.width));
         pjo["bitmap_height"] = picojson::value(float(final_bitmap.height));
+        if(dm_opts.msdf) {
+            pjo["channels"] = picojson::value(3.0);
+        }
         
         picojson::object json_glyph_data;
         json_glyph_data.clear();
@@ -0,0 +1,618 @@
+//
+//  outline_sdf.cpp
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#include <cmath>
+#include <algorithm>
+
+#include "outline_sdf.h"
+#include "parallel.h"
+
+static const double SDF_PI = 3.14159265358979323846;
+
+// Flattening tolerance (in shape units) for the winding-number polyline.
+static const float FLAT_TOLERANCE = 0.2f;
+
+// ------------------------------------------------------- outline import ---
+
+struct decompose_state
+{
+    outline_shape *shape;
+    sdf_point last;
+};
+
+static inline sdf_point ft_point(const FT_Vector *v)
+{
+    sdf_point p = { v->x/64.0f, v->y/64.0f };
+    return p;
+}
+
+static int decompose_move_to(const FT_Vector *to, void *user)
+{
+    decompose_state *st = (decompose_state *)user;
+    st->last = ft_point(to);
+    st->shape->contours += 1;
+    return 0;
+}
+
+static void add_segment(decompose_state *st, int order, const sdf_point *pts)
+{
+    shape_segment seg;
+    seg.order = order;
+    seg.p[0] = st->last;
+    for(int k = 1; k <= order; k++) seg.p[k] = pts[k-1];
+    seg.contour = st->shape->contours - 1;
+    seg.color = EDGE_WHITE;
+    st->last = seg.p[order];
+    if(order == 1 && seg.p[0].x == seg.p[1].x && seg.p[0].y == seg.p[1].y) {
+        return; // Degenerate closing segment
+    }
+    st->shape->segments.push_back(seg);
+}
+
+static int decompose_line_to(const FT_Vector *to, void *user)
+{
+    sdf_point pts[1] = { ft_point(to) };
+    add_segment((decompose_state *)user, 1, pts);
+    return 0;
+}
+
+static int decompose_conic_to(const FT_Vector *control, const FT_Vector *to, void *user)
+{
+    sdf_point pts[2] = { ft_point(control), ft_point(to) };
+    add_segment((decompose_state *)user, 2, pts);
+    return 0;
+}
+
+static int decompose_cubic_to(const FT_Vector *control1, const FT_Vector *control2,
+                              const FT_Vector *to, void *user)
+{
+    sdf_point pts[3] = { ft_point(control1), ft_point(control2), ft_point(to) };
+    add_segment((decompose_state *)user, 3, pts);
+    return 0;
+}
+
+static inline sdf_point segment_point(shape_segment const & seg, float t)
+{
+    float s = 1-t;
+    sdf_point r;
+    switch(seg.order) {
+        case 1:
+            r.x = s*seg.p[0].x + t*seg.p[1].x;
+            r.y = s*seg.p[0].y + t*seg.p[1].y;
+            break;
+        case 2:
+            r.x = s*s*seg.p[0].x + 2*s*t*seg.p[1].x + t*t*seg.p[2].x;
+            r.y = s*s*seg.p[0].y + 2*s*t*seg.p[1].y + t*t*seg.p[2].y;
+            break;
+        default:
+            r.x = s*s*s*seg.p[0].x + 3*s*s*t*seg.p[1].x + 3*s*t*t*seg.p[2].x + t*t*t*seg.p[3].x;
+            r.y = s*s*s*seg.p[0].y + 3*s*s*t*seg.p[1].y + 3*s*t*t*seg.p[2].y + t*t*t*seg.p[3].y;
+            break;
+    }
+    return r;
+}
+
+// Direction of the curve at t. At an end point whose control point
+// coincides with it, the direction to the next distinct point is used.
+static inline sdf_point segment_tangent(shape_segment const & seg, float t)
+{
+    const sdf_point *P = seg.p;
+    sdf_point r;
+    if(seg.order == 1) {
+        r.x = P[1].x - P[0].x;
+        r.y = P[1].y - P[0].y;
+        return r;
+    }
+    if(seg.order == 2) {
+        r.x = 2*((1-t)*(P[1].x - P[0].x) + t*(P[2].x - P[1].x));
+        r.y = 2*((1-t)*(P[1].y - P[0].y) + t*(P[2].y - P[1].y));
+    } else {
+        float s = 1-t;
+        r.x = 3*(s*s*(P[1].x - P[0].x) + 2*s*t*(P[2].x - P[1].x) + t*t*(P[3].x - P[2].x));
+        r.y = 3*(s*s*(P[1].y - P[0].y) + 2*s*t*(P[2].y - P[1].y) + t*t*(P[3].y - P[2].y));
+    }
+    if(r.x == 0 && r.y == 0) {
+        const sdf_point & a = (t <= 0.5f) ? P[0] : P[1];
+        const sdf_point & b = (t <= 0.5f) ? P[2] : P[seg.order];
+        r.x = b.x - a.x;
+        r.y = b.y - a.y;
+    }
+    return r;
+}
+
+static inline sdf_point normalized(sdf_point v)
+{
+    float len = std::sqrt(v.x*v.x + v.y*v.y);
+    if(len > 0) { v.x /= len; v.y /= len; }
+    return v;
+}
+
+static inline float cross(sdf_point a, sdf_point b)
+{
+    return a.x*b.y - a.y*b.x;
+}
+
+static inline float dot(sdf_point a, sdf_point b)
+{
+    return a.x*b.x + a.y*b.y;
+}
+
+bool outline_shape_from_ft(FT_Outline * outline, outline_shape & shape)
+{
+    shape = outline_shape();
+    shape.even_odd = (outline->flags & FT_OUTLINE_EVEN_ODD_FILL) != 0;
+    shape.fill_right = (FT_Outline_Get_Orientation(outline) != FT_ORIENTATION_POSTSCRIPT);
+    
+    FT_Outline_Funcs funcs;
+    funcs.move_to = decompose_move_to;
+    funcs.line_to = decompose_line_to;
+    funcs.conic_to = decompose_conic_to;
+    funcs.cubic_to = decompose_cubic_to;
+    funcs.shift = 0;
+    funcs.delta = 0;
+    
+    decompose_state st;
+    st.shape = &shape;
+    st.last.x = st.last.y = 0;
+    if(FT_Outline_Decompose(outline, &funcs, &st)) {
+        return false;
+    }
+    
+    // Flatten curves into short lines for the winding number.
+    for(size_t i = 0; i < shape.segments.size(); i++) {
+        shape_segment const & seg = shape.segments[i];
+        int n = 1;
+        if(seg.order > 1) {
+            // Deviation of the control polygon from the chord bounds the
+            // flattening error; split until it is below the tolerance.
+            float dev = 0;
+            for(int k = 1; k < seg.order; k++) {
+                float mx = seg.p[k-1].x - 2*seg.p[k].x + seg.p[k+1].x;
+                float my = seg.p[k-1].y - 2*seg.p[k].y + seg.p[k+1].y;
+                dev = std::max(dev, std::sqrt(mx*mx + my*my));
+            }
+            n = std::min(64, 1 + (int)std::sqrt(dev / FLAT_TOLERANCE));
+        }
+        sdf_point a = seg.p[0];
+        for(int k = 1; k <= n; k++) {
+            sdf_point b = (k == n) ? seg.p[seg.order] : segment_point(seg, (float)k/n);
+            shape_line l = { a, b };
+            shape.flat.push_back(l);
+            a = b;
+        }
+    }
+    return true;
+}
+
+// ------------------------------------------------------------ distance ---
+
+// Real roots of a*t^3 + b*t^2 + c*t + d = 0. Returns the number of roots.
+static int solve_cubic(double a, double b, double c, double d, double roots[3])
+{
+    if(std::fabs(a) < 1e-12) {
+        if(std::fabs(b) < 1e-12) {
+            if(std::fabs(c) < 1e-12) return 0;
+            roots[0] = -d/c;
+            return 1;
+        }
+        double disc = c*c - 4*b*d;
+        if(disc < 0) return 0;
+        disc = std::sqrt(disc);
+        roots[0] = (-c + disc) / (2*b);
+        roots[1] = (-c - disc) / (2*b);
+        return 2;
+    }
+    b /= a; c /= a; d /= a;
+    double q = (b*b - 3*c) / 9;
+    double r = (b*(2*b*b - 9*c) + 27*d) / 54;
+    double q3 = q*q*q;
+    b /= 3;
+    if(r*r < q3) {
+        double th = std::acos(std::max(-1.0, std::min(1.0, r / std::sqrt(q3))));
+        double m = -2*std::sqrt(q);
+        roots[0] = m*std::cos(th/3) - b;
+        roots[1] = m*std::cos((th + 2*SDF_PI)/3) - b;
+        roots[2] = m*std::cos((th - 2*SDF_PI)/3) - b;
+        return 3;
+    }
+    double A = -std::cbrt(std::fabs(r) + std::sqrt(r*r - q3));
+    if(r < 0) A = -A;
+    double B = (A == 0) ? 0 : q/A;
+    roots[0] = (A + B) - b;
+    return 1;
+}
+
+static inline float dist2(sdf_point a, sdf_point b)
+{
+    float dx = a.x - b.x, dy = a.y - b.y;
+    return dx*dx + dy*dy;
+}
+
+float segment_distance(shape_segment const & seg, sdf_point p, float & t)
+{
+    const sdf_point *P = seg.p;
+    if(seg.order == 1) {
+        float ex = P[1].x - P[0].x, ey = P[1].y - P[0].y;
+        float len2 = ex*ex + ey*ey;
+        t = (len2 > 0) ? ((p.x - P[0].x)*ex + (p.y - P[0].y)*ey) / len2 : 0;
+        t = std::min(1.0f, std::max(0.0f, t));
+        return std::sqrt(dist2(segment_point(seg, t), p));
+    }
+    
+    // Candidates: both end points plus the stationary points of |B(t)-p|^2
+    float best_t = 0;
+    float best = dist2(P[0], p);
+    float d1 = dist2(P[seg.order], p);
+    if(d1 < best) { best = d1; best_t = 1; }
+    
+    if(seg.order == 2) {
+        double qax = P[0].x - p.x, qay = P[0].y - p.y;
+        double abx = P[1].x - P[0].x, aby = P[1].y - P[0].y;
+        double brx = P[2].x - P[1].x - abx, bry = P[2].y - P[1].y - aby;
+        double roots[3];
+        int n = solve_cubic(brx*brx + bry*bry,
+                            3*(abx*brx + aby*bry),
+                            2*(abx*abx + aby*aby) + (qax*brx + qay*bry),
+                            qax*abx + qay*aby, roots);
+        for(int k = 0; k < n; k++) {
+            if(roots[k] > 0 && roots[k] < 1) {
+                float d = dist2(segment_point(seg, (float)roots[k]), p);
+                if(d < best) { best = d; best_t = (float)roots[k]; }
+            }
+        }
+    } else {
+        // Newton iterations on dot(B(t)-p, B'(t)) from a few starting points
+        for(int start = 0; start <= 4; start++) {
+            double tt = start / 4.0;
+            for(int it = 0; it < 5; it++) {
+                double s = 1 - tt;
+                double bx = s*s*s*P[0].x + 3*s*s*tt*P[1].x + 3*s*tt*tt*P[2].x + tt*tt*tt*P[3].x - p.x;
+                double by = s*s*s*P[0].y + 3*s*s*tt*P[1].y + 3*s*tt*tt*P[2].y + tt*tt*tt*P[3].y - p.y;
+                double d1x = 3*(s*s*(P[1].x-P[0].x) + 2*s*tt*(P[2].x-P[1].x) + tt*tt*(P[3].x-P[2].x));
+                double d1y = 3*(s*s*(P[1].y-P[0].y) + 2*s*tt*(P[2].y-P[1].y) + tt*tt*(P[3].y-P[2].y));
+                double d2x = 6*(s*(P[2].x - 2*P[1].x + P[0].x) + tt*(P[3].x - 2*P[2].x + P[1].x));
+                double d2y = 6*(s*(P[2].y - 2*P[1].y + P[0].y) + tt*(P[3].y - 2*P[2].y + P[1].y));
+                double f = bx*d1x + by*d1y;
+                double df = d1x*d1x + d1y*d1y + bx*d2x + by*d2y;
+                if(df == 0) break;
+                tt -= f/df;
+                if(tt <= 0 || tt >= 1) break;
+            }
+            if(tt > 0 && tt < 1) {
+                float d = dist2(segment_point(seg, (float)tt), p);
+                if(d < best) { best = d; best_t = (float)tt; }
+            }
+        }
+    }
+    t = best_t;
+    return std::sqrt(best);
+}
+
+// ------------------------------------------------------------ sampling ---
+
+// Segments bucketed into square cells over the output area. A cell lists
+// every segment whose bounding box, grown by the spread, touches it.
+struct segment_grid
+{
+    float left, top, cell;
+    int gw, gh;
+    std::vector< std::vector<int> > cells;
+    
+    std::vector<int> const & at(sdf_point p) const {
+        int cx = std::max(0, std::min(gw-1, (int)((p.x - left) / cell)));
+        int cy = std::max(0, std::min(gh-1, (int)((top - p.y) / cell)));
+        return cells[cy*gw + cx];
+    }
+};
+
+static void build_grid(outline_shape const & shape, int width, int height,
+                       float origin_x, float origin_y, float step, float spread,
+                       segment_grid & grid)
+{
+    grid.cell = std::max(spread, step);
+    grid.left = origin_x;
+    grid.top = origin_y;
+    grid.gw = std::max(1, (int)std::ceil(width*step / grid.cell));
+    grid.gh = std::max(1, (int)std::ceil(height*step / grid.cell));
+    grid.cells.assign(grid.gw*grid.gh, std::vector<int>());
+    
+    for(size_t s = 0; s < shape.segments.size(); s++) {
+        shape_segment const & seg = shape.segments[s];
+        float x0 = seg.p[0].x, x1 = x0, y0 = seg.p[0].y, y1 = y0;
+        for(int k = 1; k <= seg.order; k++) {
+            x0 = std::min(x0, seg.p[k].x); x1 = std::max(x1, seg.p[k].x);
+            y0 = std::min(y0, seg.p[k].y); y1 = std::max(y1, seg.p[k].y);
+        }
+        int cx0 = std::max(0, (int)std::floor((x0 - spread - grid.left) / grid.cell));
+        int cx1 = std::min(grid.gw-1, (int)std::floor((x1 + spread - grid.left) / grid.cell));
+        int cy0 = std::max(0, (int)std::floor((grid.top - (y1 + spread)) / grid.cell));
+        int cy1 = std::min(grid.gh-1, (int)std::floor((grid.top - (y0 - spread)) / grid.cell));
+        for(int cy = cy0; cy <= cy1; cy++) {
+            for(int cx = cx0; cx <= cx1; cx++) {
+                grid.cells[cy*grid.gw + cx].push_back((int)s);
+            }
+        }
+    }
+}
+
+// Sorted crossings (x, direction) of the horizontal line at y with the
+// flattened outline; summing directions left of a point gives its winding.
+static void row_crossings(outline_shape const & shape, float y,
+                          std::vector< std::pair<float,int> > & crossings)
+{
+    crossings.clear();
+    for(size_t e = 0; e < shape.flat.size(); e++) {
+        shape_line const & l = shape.flat[e];
+        int dir = 0;
+        if(l.a.y <= y && l.b.y > y) dir = 1;
+        else if(l.b.y <= y && l.a.y > y) dir = -1;
+        if(dir == 0) continue;
+        float x = l.a.x + (y - l.a.y) * (l.b.x - l.a.x) / (l.b.y - l.a.y);
+        crossings.push_back(std::make_pair(x, dir));
+    }
+    std::sort(crossings.begin(), crossings.end());
+}
+
+void outline_sdf(outline_shape const & shape, float *out, int width, int height,
+                 float origin_x, float origin_y, float step, float spread, int threads)
+{
+    segment_grid grid;
+    build_grid(shape, width, height, origin_x, origin_y, step, spread, grid);
+    
+    parallel_for(0, height, threads, [&](int j0, int j1) {
+        std::vector< std::pair<float,int> > crossings;
+        for(int j = j0; j < j1; j++) {
+            sdf_point p;
+            p.y = origin_y - (j+0.5f)*step;
+            row_crossings(shape, p.y, crossings);
+            
+            int winding = 0;
+            size_t next = 0;
+            for(int i = 0; i < width; i++) {
+                p.x = origin_x + (i+0.5f)*step;
+                while(next < crossings.size() && crossings[next].first < p.x) {
+                    winding += crossings[next].second;
+                    next++;
+                }
+                bool inside = shape.even_odd ? ((winding & 1) != 0) : (winding != 0);
+                
+                float d = spread;
+                std::vector<int> const & cands = grid.at(p);
+                for(size_t k = 0; k < cands.size(); k++) {
+                    float t;
+                    d = std::min(d, segment_distance(shape.segments[cands[k]], p, t));
+                }
+                if(inside) d = -d;
+                out[j*width + i] = (d + spread) / (2*spread);
+            }
+        }
+    });
+}
+
+// ------------------------------------------------------- multi-channel ---
+
+static inline bool is_corner(sdf_point a, sdf_point b, float cross_threshold)
+{
+    return dot(a, b) <= 0 || std::fabs(cross(a, b)) > cross_threshold;
+}
+
+// Next of cyan, magenta, yellow after "color" that is not "banned".
+static int switch_color(int color, int banned)
+{
+    static const int palette[3] = { EDGE_CYAN, EDGE_MAGENTA, EDGE_YELLOW };
+    int start = 0;
+    for(int k = 0; k < 3; k++) {
+        if(palette[k] == color) start = k+1;
+    }
+    for(int k = 0; k < 3; k++) {
+        int c = palette[(start + k) % 3];
+        if(c != color && c != banned) return c;
+    }
+    return color;
+}
+
+void outline_color_edges(outline_shape & shape, float angle_threshold)
+{
+    const float cross_threshold = std::sin(angle_threshold);
+    std::vector<shape_segment> & segs = shape.segments;
+    size_t begin = 0;
+    while(begin < segs.size()) {
+        size_t end = begin;
+        while(end < segs.size() && segs[end].contour == segs[begin].contour) end++;
+        int n = (int)(end - begin);
+        shape_segment *c = &segs[begin];
+        
+        std::vector<int> corners;
+        for(int k = 0; k < n; k++) {
+            sdf_point a = normalized(segment_tangent(c[(k+n-1) % n], 1));
+            sdf_point b = normalized(segment_tangent(c[k], 0));
+            if(is_corner(a, b, cross_threshold)) corners.push_back(k);
+        }
+        
+        if(corners.empty()) {
+            // Smooth contour: every channel sees every edge
+            for(int k = 0; k < n; k++) c[k].color = EDGE_WHITE;
+        } else if(corners.size() == 1) {
+            // "Teardrop": split the contour into three colored runs
+            int colors[3] = { EDGE_MAGENTA, EDGE_WHITE, EDGE_YELLOW };
+            int start = corners[0];
+            if(n >= 3) {
+                for(int k = 0; k < n; k++) {
+                    int idx = 1 + (int)(3 + 2.875f*k/(n-1) - 1.4375f + 0.5f) - 3;
+                    c[(start + k) % n].color = colors[idx];
+                }
+            } else if(n == 2) {
+                c[start].color = colors[0];
+                c[(start+1) % n].color = colors[2];
+            } else {
+                c[0].color = EDGE_WHITE;
+            }
+        } else {
+            // Switch colors at every corner; the last run must also differ
+            // from the first one, which it meets at corners[0].
+            int spline = 0;
+            int start = corners[0];
+            int color = EDGE_CYAN;
+            int initial = color;
+            for(int k = 0; k < n; k++) {
+                int idx = (start + k) % n;
+                if(k > 0 && spline + 1 < (int)corners.size() && corners[spline+1] == idx) {
+                    spline++;
+                    color = switch_color(color, (spline == (int)corners.size()-1) ? initial : 0);
+                }
+                c[idx].color = color;
+            }
+        }
+        begin = end;
+    }
+}
+
+// Distance to an edge, signed by which side of the edge p is on, and
+// extended past the end points along the end tangents (pseudo-distance).
+static float signed_pseudo_distance(outline_shape const & shape, shape_segment const & seg,
+                                    sdf_point p, float dist, float t)
+{
+    sdf_point q = segment_point(seg, t);
+    sdf_point pq = { p.x - q.x, p.y - q.y };
+    float side = cross(normalized(segment_tangent(seg, t)), pq);
+    float d = (side > 0) ? dist : -dist;
+    
+    if(t <= 0) {
+        sdf_point dir = normalized(segment_tangent(seg, 0));
+        sdf_point ap = { p.x - seg.p[0].x, p.y - seg.p[0].y };
+        if(dot(ap, dir) < 0) {
+            float pd = cross(dir, ap);
+            if(std::fabs(pd) <= dist) d = pd;
+        }
+    } else if(t >= 1) {
+        sdf_point dir = normalized(segment_tangent(seg, 1));
+        sdf_point bp = { p.x - seg.p[seg.order].x, p.y - seg.p[seg.order].y };
+        if(dot(bp, dir) > 0) {
+            float pd = cross(dir, bp);
+            if(std::fabs(pd) <= dist) d = pd;
+        }
+    }
+    // Positive is "left of the edge"; make it positive outside.
+    return shape.fill_right ? d : -d;
+}
+
+static inline float median(float a, float b, float c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+void outline_msdf(outline_shape const & shape, float *out_rgb, float *out_sdf,
+                  int width, int height, float origin_x, float origin_y,
+                  float step, float spread, int threads)
+{
+    segment_grid grid;
+    build_grid(shape, width, height, origin_x, origin_y, step, spread, grid);
+    
+    parallel_for(0, height, threads, [&](int j0, int j1) {
+        std::vector< std::pair<float,int> > crossings;
+        for(int j = j0; j < j1; j++) {
+            sdf_point p;
+            p.y = origin_y - (j+0.5f)*step;
+            row_crossings(shape, p.y, crossings);
+            
+            int winding = 0;
+            size_t next = 0;
+            for(int i = 0; i < width; i++) {
+                p.x = origin_x + (i+0.5f)*step;
+                while(next < crossings.size() && crossings[next].first < p.x) {
+                    winding += crossings[next].second;
+                    next++;
+                }
+                bool inside = shape.even_odd ? ((winding & 1) != 0) : (winding != 0);
+                
+                // Closest edge per channel. Ties (edges meeting at a shared
+                // end point) go to the edge p is most perpendicular to.
+                float true_dist = spread;
+                float best[3] = { INFINITY, INFINITY, INFINITY };
+                float best_ortho[3] = { 0, 0, 0 };
+                float best_t[3] = { 0, 0, 0 };
+                int best_seg[3] = { -1, -1, -1 };
+                
+                std::vector<int> const & cands = grid.at(p);
+                for(size_t k = 0; k < cands.size(); k++) {
+                    shape_segment const & seg = shape.segments[cands[k]];
+                    float t;
+                    float dist = segment_distance(seg, p, t);
+                    true_dist = std::min(true_dist, dist);
+                    sdf_point q = segment_point(seg, t);
+                    sdf_point pq = { p.x - q.x, p.y - q.y };
+                    float ortho = (dist > 0) ? std::fabs(cross(normalized(segment_tangent(seg, t)), pq)) / dist : 1;
+                    for(int ch = 0; ch < 3; ch++) {
+                        if(!(seg.color & (1 << ch))) continue;
+                        if(dist < best[ch] - 1e-4f ||
+                           (dist < best[ch] + 1e-4f && ortho > best_ortho[ch])) {
+                            best[ch] = dist;
+                            best_ortho[ch] = ortho;
+                            best_t[ch] = t;
+                            best_seg[ch] = cands[k];
+                        }
+                    }
+                }
+                
+                float true_sd = inside ? -true_dist : true_dist;
+                float d[3];
+                for(int ch = 0; ch < 3; ch++) {
+                    if(best_seg[ch] < 0) {
+                        d[ch] = inside ? -spread : spread;
+                    } else {
+                        d[ch] = signed_pseudo_distance(shape, shape.segments[best_seg[ch]],
+                                                       p, best[ch], best_t[ch]);
+                    }
+                }
+                // Error correction: never let the median flip the sign.
+                if((median(d[0], d[1], d[2]) < 0) != inside) {
+                    d[0] = d[1] = d[2] = true_sd;
+                }
+                
+                int idx = j*width + i;
+                for(int ch = 0; ch < 3; ch++) {
+                    float v = std::min(spread, std::max(-spread, d[ch]));
+                    out_rgb[idx*3 + ch] = (v + spread) / (2*spread);
+                }
+                if(out_sdf) {
+                    out_sdf[idx] = (true_sd + spread) / (2*spread);
+                }
+            }
+        }
+    });
+}
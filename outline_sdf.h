@@ -0,0 +1,138 @@
+//
+//  outline_sdf.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__outline_sdf__
+#define __makeglfont__outline_sdf__
+
+#include <vector>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+struct sdf_point
+{
+    float x, y;
+};
+
+// Edge colors for multi-channel distance fields: a mask of the channels
+// (red, green, blue) an edge contributes to.
+enum edge_color
+{
+    EDGE_RED = 1, EDGE_GREEN = 2, EDGE_BLUE = 4,
+    EDGE_YELLOW = 3, EDGE_MAGENTA = 5, EDGE_CYAN = 6, EDGE_WHITE = 7
+};
+
+// One piece of an outline: a line (order 1), a conic/quadratic Bezier
+// (order 2) or a cubic Bezier (order 3), with control points p[0..order].
+struct shape_segment
+{
+    int order;
+    sdf_point p[4];
+    int contour;
+    int color; // edge_color, EDGE_WHITE unless outline_color_edges() ran
+};
+
+struct shape_line
+{
+    sdf_point a, b;
+};
+
+/**
+ * A glyph outline as a list of segments, plus a flattened copy of it that
+ * is only used to compute winding numbers (inside/outside).
+ */
+struct outline_shape
+{
+    std::vector<shape_segment> segments;
+    std::vector<shape_line> flat;
+    int contours;
+    bool even_odd;   // FT_OUTLINE_EVEN_ODD_FILL, otherwise the nonzero rule
+    bool fill_right; // filled area is to the right of the contour direction (TrueType)
+    
+    outline_shape():segments(), flat(), contours(0), even_odd(false), fill_right(true) {}
+};
+
+// Builds a shape from a FreeType outline (in 26.6 units; the shape is in
+// pixels). Returns false if FreeType fails to decompose it.
+bool outline_shape_from_ft(FT_Outline * outline, outline_shape & shape);
+
+// Distance from p to segment seg; t receives the curve parameter [0,1] of
+// the closest point.
+float segment_distance(shape_segment const & seg, sdf_point p, float & t);
+
+/**
+ * outline_sdf()
+ * Evaluates the signed distance field of a shape analytically on a grid of
+ * width x height texels. Texel (i,j), with j counted from the top row, is
+ * sampled at (origin_x + (i+0.5)*step, origin_y - (j+0.5)*step) in shape
+ * coordinates. Distances are clamped to +/-spread (shape units) and stored
+ * as (d + spread) / (2*spread), with d positive outside the shape; this is
+ * the same [0,1] convention as make_distance_map().
+ * Segments are bucketed in a grid of spread-sized cells so each texel only
+ * looks at the segments that can be within the spread.
+ * Rows are split across "threads" workers (0 = all cores).
+ */
+void outline_sdf(outline_shape const & shape, float *out, int width, int height,
+                 float origin_x, float origin_y, float step, float spread, int threads);
+
+/**
+ * outline_color_edges()
+ * Assigns edge colors for a multi-channel distance field, in the manner of
+ * Chlumsky's msdfgen ("simple" edge coloring): contours are split at
+ * corners sharper than angle_threshold (radians of deviation from a
+ * straight line, msdfgen uses 3.0), and neighboring edges across a corner
+ * never share more than one channel. Smooth contours stay white.
+ */
+void outline_color_edges(outline_shape & shape, float angle_threshold);
+
+/**
+ * outline_msdf()
+ * Multi-channel version of outline_sdf(). For every texel and channel the
+ * closest edge of that color is found and its signed pseudo-distance (the
+ * distance to the edge's tangent line past its end points) is stored in
+ * out_rgb (3 floats per texel, same [0,1] convention as outline_sdf()).
+ * Texels whose channel median disagrees with the true inside/outside test
+ * fall back to the true distance in all channels. out_sdf (may be NULL)
+ * receives the ordinary single-channel field.
+ */
+void outline_msdf(outline_shape const & shape, float *out_rgb, float *out_sdf,
+                  int width, int height, float origin_x, float origin_y,
+                  float step, float spread, int threads);
+
+#endif /* defined(__makeglfont__outline_sdf__) */
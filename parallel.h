@@ -0,0 +1,76 @@
+//
+//  parallel.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__parallel__
+#define __makeglfont__parallel__
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * parallel_for()
+ * Splits [begin, end) into at most "threads" contiguous ranges and calls
+ * fn(lo, hi) for each range on its own thread. With threads <= 1, or a
+ * range too small to split, fn is called once on the calling thread.
+ * threads == 0 means "use every hardware thread".
+ */
+template <typename F>
+inline void parallel_for(int begin, int end, int threads, F fn)
+{
+    if(threads == 0) {
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    int n = end - begin;
+    threads = std::min(threads, n);
+    if(threads <= 1) {
+        if(n > 0) fn(begin, end);
+        return;
+    }
+    std::vector<std::thread> workers;
+    int chunk = (n + threads - 1) / threads;
+    for(int lo = begin + chunk; lo < end; lo += chunk) {
+        workers.push_back(std::thread(fn, lo, std::min(lo + chunk, end)));
+    }
+    fn(begin, std::min(begin + chunk, end));
+    for(size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+#endif /* defined(__makeglfont__parallel__) */
@@ -0,0 +1,138 @@
+//
+//  span_raster.h
+//  makeglfont
+//
+
+/* =========================================================================
+ * MakeGLFont
+ * Platform:    Any
+ * WWW:
+ * -------------------------------------------------------------------------
+ * Copyright 2013 Raphael Martelles. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY RAPHAEL MARTELLES ''AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL RAPHAEL MARTELLES OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation are
+ * those of the authors and should not be interpreted as representing official
+ * policies, either expressed or implied, of Raphael Martelles.
+ * ========================================================================= */
+
+#ifndef __makeglfont__span_raster__
+#define __makeglfont__span_raster__
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * A horizontal run of pixels with the same coverage (1..255).
+ */
+struct span_run
+{
+    int x, len;
+    unsigned char coverage;
+};
+
+/**
+ * span_raster
+ * An anti-aliased image stored as runs of equal coverage, row by row
+ * from the top; pixels outside every run are empty. A supersampled glyph
+ * is mostly long fully-covered or empty runs, with partial coverage only
+ * along the outline, so this is a small fraction of the bitmap's size.
+ *
+ * Fill it with reset() and add() (rows in any order, left to right within
+ * a row, as FreeType's span callback delivers them), then finish().
+ */
+struct span_raster
+{
+    int width, height;
+    std::vector<span_run> runs;   // row after row, left to right
+    std::vector<int> row_start;   // runs of row y are [row_start[y], row_start[y+1])
+    
+    span_raster():width(0), height(0) {}
+    
+    void reset(int w, int h) {
+        width = w;
+        height = h;
+        runs.clear();
+        pending_rows.clear();
+        row_start.assign(h+1, 0);
+    }
+    
+    // Adds len pixels of coverage c starting at (x,y), clipped to the image.
+    void add(int x, int y, int len, unsigned char c) {
+        if(c == 0 || y < 0 || y >= height) return;
+        int x1 = std::min(x + len, width);
+        x = std::max(x, 0);
+        if(x >= x1) return;
+        // Merge with the previous run of the row if it continues it.
+        if(!runs.empty() && pending_rows.back() == y) {
+            span_run & last = runs.back();
+            if(last.coverage == c && last.x + last.len == x) {
+                last.len += x1 - x;
+                return;
+            }
+        }
+        span_run r = { x, x1 - x, c };
+        runs.push_back(r);
+        pending_rows.push_back(y);
+        row_start[y+1]++;
+    }
+    
+    // Sorts the runs added since reset() by row.
+    void finish() {
+        for(int y = 0; y < height; y++) {
+            row_start[y+1] += row_start[y];
+        }
+        std::vector<span_run> sorted(runs.size());
+        std::vector<int> fill(row_start.begin(), row_start.end()-1);
+        for(size_t k = 0; k < runs.size(); k++) {
+            sorted[fill[pending_rows[k]]++] = runs[k];
+        }
+        runs.swap(sorted);
+        pending_rows.clear();
+    }
+    
+    // Coverage of pixels [x0,x1) of row y into out; 0 outside the image.
+    void row_coverage(int y, int x0, int x1, unsigned char *out) const {
+        std::fill(out, out + (x1 - x0), (unsigned char)0);
+        if(y < 0 || y >= height) return;
+        const span_run *r = first_run(y, x0), *end = runs.data() + row_start[y+1];
+        for(; r != end && r->x < x1; ++r) {
+            int a = std::max(r->x, x0), b = std::min(r->x + r->len, x1);
+            std::fill(out + (a - x0), out + (b - x0), r->coverage);
+        }
+    }
+    
+    // The first run of row y that ends after x.
+    const span_run * first_run(int y, int x) const {
+        const span_run *begin = runs.data() + row_start[y], *end = runs.data() + row_start[y+1];
+        while(begin != end && begin->x + begin->len <= x) {
+            ++begin;
+        }
+        return begin;
+    }
+    
+private:
+    std::vector<int> pending_rows; // row of each run until finish()
+};
+
+#endif /* defined(__makeglfont__span_raster__) */